@@ -0,0 +1,151 @@
+// Affinity.h
+// CPU and NUMA node discovery, and pinning of worker threads to CPUs
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#define AFFINITY_LINUX 1
+#endif
+
+// Placement policies for the worker pool
+//   none:    threads float, the OS schedules them anywhere
+//   compact: fill the CPUs of one NUMA node before using the next
+//   spread:  deal threads round-robin over the nodes
+// Pinned workers first-touch their own result and segment buffers, so
+// with Linux's default local allocation that memory lands on their node.
+// Topology comes from /sys; elsewhere (or if /sys is unreadable) every
+// CPU counts as one node and pinning is a no-op
+class Affinity {
+public:
+    static bool isPolicy(const std::string& name) {
+        return name == "none" || name == "compact" || name == "spread";
+    }
+
+    // Allowed CPUs of each NUMA node that has any, in node order
+    static std::vector<std::vector<int>> nodes() {
+        std::vector<std::vector<int>> result;
+        std::vector<int> allowed = allowedCpus();
+#if defined(AFFINITY_LINUX)
+        std::vector<int> ids;
+        if (DIR* dir = opendir("/sys/devices/system/node")) {
+            while (dirent* entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                    name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                    ids.push_back(std::stoi(name.substr(4)));
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(ids.begin(), ids.end());
+        for (int id : ids) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) result.push_back(cpus);
+        }
+#endif
+        if (result.empty()) result.push_back(allowed);
+        return result;
+    }
+
+    // CPU for each of count workers under policy; empty for "none"
+    static std::vector<int> placement(const std::string& policy, int count) {
+        std::vector<int> order;
+        if (policy != "compact" && policy != "spread") return order;
+
+        std::vector<std::vector<int>> topology = nodes();
+        if (policy == "compact") {
+            for (const auto& node : topology) order.insert(order.end(), node.begin(), node.end());
+        } else {
+            for (size_t k = 0; order.size() < countCpus(topology); k++) {
+                for (const auto& node : topology) {
+                    if (k < node.size()) order.push_back(node[k]);
+                }
+            }
+        }
+
+        // More workers than CPUs wrap around
+        std::vector<int> cpus;
+        for (int i = 0; i < count && !order.empty(); i++) {
+            cpus.push_back(order[i % order.size()]);
+        }
+        return cpus;
+    }
+
+    // Pins the calling thread to cpu; false if that is not possible here
+    static bool pinCurrentThread(int cpu) {
+#if defined(AFFINITY_LINUX)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // Parses a Linux CPU list such as "0-3,8,10-11"
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            size_t dash = range.find('-');
+            try {
+                int first = std::stoi(range.substr(0, dash));
+                int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+            } catch (const std::exception&) {
+                // Blank or malformed entry: skip it
+            }
+        }
+        return cpus;
+    }
+
+private:
+    // CPUs this process may run on
+    static std::vector<int> allowedCpus() {
+        std::vector<int> cpus;
+#if defined(AFFINITY_LINUX)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+        }
+#endif
+        if (cpus.empty()) {
+            int count = std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < count; cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    static size_t countCpus(const std::vector<std::vector<int>>& topology) {
+        size_t total = 0;
+        for (const auto& node : topology) total += node.size();
+        return total;
+    }
+};
+
+#endif
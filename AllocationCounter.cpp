@@ -0,0 +1,42 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+// Replacement global allocation functions that count each allocation
+// The array and nothrow forms forward to these in the standard library, so
+// they are counted too
+
+void* operator new(std::size_t size) {
+    AllocationCounter::increment();
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    AllocationCounter::increment();
+    std::size_t alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(size ? size : 1, alignment)) return p;
+#else
+    // aligned_alloc needs the size to be a multiple of the alignment
+    std::size_t rounded = (size + alignment - 1) / alignment * alignment;
+    if (void* p = std::aligned_alloc(alignment, rounded ? rounded : alignment)) return p;
+#endif
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
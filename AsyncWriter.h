@@ -0,0 +1,185 @@
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <iostream>
+#include "CacheLine.h"
+
+// Background writer for immediate print mode
+// Worker threads push (thread ID, prime, timestamp) records into a bounded
+// lock-free queue and return at once; a single writer thread formats them
+// into a large buffer and writes it to stdout in batches, either when the
+// buffer fills up or every FLUSH_INTERVAL_MS, whichever comes first
+class AsyncWriter {
+private:
+    static const size_t QUEUE_CAPACITY = 1 << 16;   // Must be a power of two
+    static const size_t BATCH_BYTES = 1 << 16;
+    static const int FLUSH_INTERVAL_MS = 50;
+
+    struct Record {
+        int threadId;
+        uint64_t number;
+        std::chrono::system_clock::time_point time;
+    };
+
+    // Slot of the bounded multi-producer queue (Vyukov's design): the
+    // sequence number says whether the slot is free for the producer at
+    // position pos (sequence == pos) or holds a record (sequence == pos + 1)
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(PADDED_ALIGNMENT) std::atomic<size_t> enqueuePos{0};
+    alignas(PADDED_ALIGNMENT) size_t dequeuePos = 0; // Only touched by the writer thread
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+    alignas(PADDED_ALIGNMENT) std::atomic<uint64_t> stalls{0}; // Pushes that found the queue full
+    std::atomic<uint64_t> stallNanos{0};            // and the time they spent yielding
+
+    // Cached "HH:MM:SS" so localtime only runs when the second changes
+    std::time_t cachedSecond = -1;
+    char cachedClock[16] = {0};
+
+    bool tryPush(const Record& record) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & (QUEUE_CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.record = record;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // Queue is full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(Record& record) {
+        Cell& cell = cells[dequeuePos & (QUEUE_CAPACITY - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1) return false;   // Nothing published yet
+
+        record = cell.record;
+        cell.sequence.store(dequeuePos + QUEUE_CAPACITY, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+
+    // Same layout as the original printResult line
+    void format(const Record& record, std::string& out) {
+        std::time_t second = std::chrono::system_clock::to_time_t(record.time);
+        if (second != cachedSecond) {
+            std::tm timeinfo;
+#ifdef _WIN32
+            localtime_s(&timeinfo, &second);
+#else
+            localtime_r(&second, &timeinfo);
+#endif
+            std::strftime(cachedClock, sizeof(cachedClock), "%H:%M:%S", &timeinfo);
+            cachedSecond = second;
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            record.time.time_since_epoch()).count() % 1000;
+
+        char line[96];
+        int length = std::snprintf(line, sizeof(line), "[Thread-%d] [%s.%03d] Found prime: %llu\n",
+                                   record.threadId, cachedClock, static_cast<int>(ms),
+                                   static_cast<unsigned long long>(record.number));
+        out.append(line, static_cast<size_t>(length));
+    }
+
+    void flush(std::string& out) {
+        if (out.empty()) return;
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+        std::cout.flush();
+        out.clear();
+    }
+
+    void writerLoop() {
+        std::string out;
+        out.reserve(BATCH_BYTES + 128);
+        auto lastFlush = std::chrono::steady_clock::now();
+        Record record;
+
+        while (true) {
+            bool drained = true;
+            while (tryPop(record)) {
+                drained = false;
+                format(record, out);
+                if (out.size() >= BATCH_BYTES) break;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (out.size() >= BATCH_BYTES ||
+                now - lastFlush >= std::chrono::milliseconds(FLUSH_INTERVAL_MS)) {
+                flush(out);
+                lastFlush = now;
+            }
+
+            if (drained) {
+                // Queue was empty: stop once producers are done, otherwise nap
+                if (stopping.load(std::memory_order_acquire)) {
+                    while (tryPop(record)) format(record, out);
+                    flush(out);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+public:
+    AsyncWriter() : cells(new Cell[QUEUE_CAPACITY]) {
+        for (size_t i = 0; i < QUEUE_CAPACITY; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        writer = std::thread(&AsyncWriter::writerLoop, this);
+    }
+
+    // Drains every queued record before returning
+    ~AsyncWriter() {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    // Called by worker threads; never touches stdout. Only if the writer
+    // falls a whole queue behind does the caller yield until a slot frees up
+    void push(int threadId, uint64_t number) {
+        Record record{threadId, number, std::chrono::system_clock::now()};
+        if (tryPush(record)) return;
+
+        auto begin = std::chrono::steady_clock::now();
+        while (!tryPush(record)) {
+            std::this_thread::yield();
+        }
+        auto waited = std::chrono::steady_clock::now() - begin;
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        stallNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                             std::memory_order_relaxed);
+    }
+
+    // Backpressure so far: pushes that had to wait, and their total wait
+    uint64_t stallCount() const { return stalls.load(std::memory_order_relaxed); }
+    double stallSeconds() const { return stallNanos.load(std::memory_order_relaxed) * 1e-9; }
+};
+
+#endif
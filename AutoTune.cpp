@@ -0,0 +1,114 @@
+#include "AutoTune.h"
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+// Parses a /sys cache size such as "48K" or "2048K"
+static size_t parseCacheSize(const std::string& text) {
+    size_t value = 0;
+    size_t i = 0;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9') value = value * 10 + (text[i++] - '0');
+    if (i < text.size() && text[i] == 'K') value <<= 10;
+    if (i < text.size() && text[i] == 'M') value <<= 20;
+    return value;
+}
+
+CacheInfo CacheInfo::detect() {
+    CacheInfo info;
+#if defined(__linux__)
+    for (int index = 0; index < 8; index++) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::ifstream levelFile(dir + "level"), typeFile(dir + "type"), sizeFile(dir + "size");
+        int level = 0;
+        std::string type, size;
+        if (!(levelFile >> level) || !(typeFile >> type) || !(sizeFile >> size)) break;
+        if (type == "Instruction") continue;
+        size_t bytes = parseCacheSize(size);
+        if (level == 1) info.l1d = bytes;
+        if (level == 2) info.l2 = bytes;
+        if (level == 3) info.l3 = bytes;
+    }
+#endif
+    return info;
+}
+
+AutoTuner::AutoTuner(const EngineOptions& baseOptions, uint64_t lowNumber, uint64_t highNumber)
+    : base(baseOptions), low(lowNumber), high(highNumber),
+      hardware(std::max(1u, std::thread::hardware_concurrency())), cache(CacheInfo::detect()),
+      resultStore(baseOptions.result_store) {
+    if (low > high || high > PrimeEngine::MAX_NUMBER) {
+        throw std::invalid_argument("AutoTuner: low must not exceed high, high must not exceed 2^63");
+    }
+    if (high - low < MIN_SAMPLE - 1) {
+        high = std::min(low + (MIN_SAMPLE - 1), PrimeEngine::MAX_NUMBER);
+        low = high - (MIN_SAMPLE - 1);
+    }
+    base.division_scheme = "sieve";   // Each trial sets its own; the caller's may be "auto"
+    base.result_store = "aggregate";
+    base.trace = false;
+}
+
+// Numbers per second of options on a sample ending at high
+double AutoTuner::measure(PrimeEngine& engine, const EngineOptions& options) {
+    engine.setOptions(options);
+    uint64_t span = high - low;   // One less than the window size
+    uint64_t sample = MIN_SAMPLE - 1;   // The window holds at least MIN_SAMPLE numbers
+    while (true) {
+        SearchResult result = engine.search(high - sample, high);
+        double seconds = std::max(result.seconds, 1e-9);
+        if (result.seconds >= MIN_TRIAL_SECONDS || sample == span || sample >= MAX_SAMPLE) {
+            double rate = (sample + 1) / seconds;
+            history.push_back({options, sample + 1, result.seconds, rate});
+            return rate;
+        }
+        sample = std::min(sample * 2 + 1, span);
+    }
+}
+
+EngineOptions AutoTuner::run() {
+    PrimeEngine engine(base);
+    EngineOptions best = base;
+    best.num_threads = static_cast<int>(hardware);
+    best.scheduler = "static";
+    double bestRate = 0;
+    auto consider = [&](const EngineOptions& options) {
+        double rate = measure(engine, options);
+        if (rate > bestRate) {
+            bestRate = rate;
+            best = options;
+        }
+    };
+
+    // 1. Scheme, with one static block per hardware thread
+    EngineOptions candidate = best;
+    for (const char* scheme : {"sieve", "range", "divisibility"}) {
+        candidate.division_scheme = scheme;
+        consider(candidate);
+    }
+
+    // 2. Dynamic chunks: the default, the numbers whose sieve bytes fill L2
+    // (8 bytes per 30 numbers), and 8 times that
+    if (best.division_scheme != "divisibility") {
+        uint64_t l2Numbers = (cache.l2 > 0 ? cache.l2 : 1 << 18) / 8 * 30;
+        std::vector<uint64_t> chunks = {8192, l2Numbers, 8 * l2Numbers};
+        candidate = best;
+        candidate.scheduler = "dynamic";
+        for (uint64_t chunk : chunks) {
+            candidate.chunk_size = static_cast<int>(std::min<uint64_t>(chunk, 1 << 30));
+            consider(candidate);
+        }
+    }
+
+    // 3. Fewer threads, which can win when the cores are shared or the
+    // pool's barriers dominate
+    candidate = best;
+    for (unsigned threads : {hardware / 2, 1u}) {
+        if (threads == 0 || static_cast<int>(threads) == best.num_threads) continue;
+        candidate.num_threads = static_cast<int>(threads);
+        consider(candidate);
+    }
+
+    best.result_store = resultStore;
+    return best;
+}
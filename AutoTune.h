@@ -0,0 +1,67 @@
+// AutoTune.h
+// Picks the engine settings for a search by timing short calibration runs
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "PrimeEngine.h"
+
+// Data cache sizes of the first CPU, in bytes; 0 where unknown. Read from
+// /sys on Linux, else left at 0
+struct CacheInfo {
+    size_t l1d = 0;
+    size_t l2 = 0;
+    size_t l3 = 0;
+
+    static CacheInfo detect();
+};
+
+// One calibration run
+struct TuneTrial {
+    EngineOptions options;
+    uint64_t numbers;         // Size of the sample window
+    double seconds;
+    double numbersPerSecond;
+};
+
+// Times the schemes, then the schedulers and chunk sizes, then the thread
+// counts, each on a sample window at the top of [low, high], where numbers
+// cost the most. Every stage keeps the fastest setting so far, so about ten
+// short runs pick all four settings. A sample starts at MIN_SAMPLE numbers
+// and doubles until one run takes MIN_TRIAL_SECONDS, capped at the window.
+// A window smaller than MIN_SAMPLE is calibrated on the MIN_SAMPLE numbers
+// from its low end instead, so timer noise and pool start-up do not pick
+// settings that are saved for every later run.
+// Runs use the aggregate store, so they allocate nothing per prime.
+// The base options supply everything else, such as primality_test
+class AutoTuner {
+public:
+    static constexpr double MIN_TRIAL_SECONDS = 0.05;
+    static const uint64_t MIN_SAMPLE = 1ULL << 16;
+    static const uint64_t MAX_SAMPLE = 1ULL << 24;
+
+    AutoTuner(const EngineOptions& base, uint64_t low, uint64_t high);
+
+    // Runs the calibration; returns the fastest options found
+    EngineOptions run();
+
+    const std::vector<TuneTrial>& trials() const { return history; }
+    unsigned hardwareThreads() const { return hardware; }
+    const CacheInfo& caches() const { return cache; }
+
+private:
+    EngineOptions base;
+    uint64_t low;                 // Calibration window: the caller's, widened to
+    uint64_t high;                // at least MIN_SAMPLE numbers
+    unsigned hardware;
+    CacheInfo cache;
+    std::string resultStore;      // The caller's, restored in the result
+    std::vector<TuneTrial> history;
+
+    double measure(PrimeEngine& engine, const EngineOptions& options);
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "Benchmark.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include "CacheLine.h"
+
+Benchmark::Benchmark(const BenchmarkOptions& opts) : options(opts) {
+    // Speedup is always reported against one thread, so make sure it is measured
+    if (std::find(options.threads.begin(), options.threads.end(), 1) == options.threads.end()) {
+        options.threads.insert(options.threads.begin(), 1);
+    }
+    options.base.print_mode = "wait";   // search() never prints in wait mode
+    options.base.test_numbers.clear();
+    options.base.output_file.clear();
+    options.base.checkpoint_file.clear();
+}
+
+// Split "a,b,c" into its non-empty items
+static std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Parse "1,2,4" into positive integers; false if any item is not one
+static bool parseIntList(const std::string& text, std::vector<int>& values) {
+    values.clear();
+    for (const std::string& item : splitList(text)) {
+        if (item.find_first_not_of("0123456789") != std::string::npos || item.size() > 9) {
+            return false;
+        }
+        int value = std::stoi(item);
+        if (value <= 0) return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+// Parse a single integer that must be at least minimum
+static bool parseCount(const std::string& text, int minimum, int& value) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoi(text);
+    return value >= minimum;
+}
+
+static void printUsage() {
+    std::cerr << "Usage: main --bench [options]\n"
+              << "  --schemes LIST      division schemes, e.g. range,divisibility,sieve\n"
+              << "  --threads LIST      thread counts, e.g. 1,2,4,8\n"
+              << "  --exponents LIST    max_number exponents X of 2^X, e.g. 16,20,24\n"
+              << "  --warmup N          untimed runs before each case (default 1)\n"
+              << "  --trials N          timed runs per case (default 5)\n"
+              << "  --scheduler NAME    static or dynamic\n"
+              << "  --chunk-size N      chunk size for the dynamic scheduler\n"
+              << "  --primality NAME    trial or miller_rabin\n"
+              << "  --store NAME        vector, bitmap or aggregate\n"
+              << "  --kernel NAME       auto, scalar, avx2, avx512 or neon\n"
+              << "  --contention        time the engine paths with padded per-thread state\n"
+              << "                      instead; compare with main-unpadded's report\n"
+              << "  --format NAME       csv or json (default csv)\n"
+              << "  --output FILE       write the report to FILE instead of stdout\n";
+}
+
+bool Benchmark::parseArgs(int argc, char* argv[], BenchmarkOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bench") continue;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return false;
+        }
+        if (arg == "--contention") {
+            opts.contention = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << arg << " needs a value\n";
+            printUsage();
+            return false;
+        }
+        std::string value = argv[++i];
+        bool ok = true;
+
+        if (arg == "--schemes") {
+            opts.schemes = splitList(value);
+            for (const std::string& scheme : opts.schemes) {
+                if (scheme != "range" && scheme != "divisibility" && scheme != "sieve") ok = false;
+            }
+            ok = ok && !opts.schemes.empty();
+        } else if (arg == "--threads") {
+            ok = parseIntList(value, opts.threads);
+        } else if (arg == "--exponents") {
+            ok = parseIntList(value, opts.exponents);
+            for (int exponent : opts.exponents) {
+                if (exponent > 63) ok = false;
+            }
+        } else if (arg == "--warmup") {
+            ok = parseCount(value, 0, opts.warmups);
+        } else if (arg == "--trials") {
+            ok = parseCount(value, 1, opts.trials);
+        } else if (arg == "--scheduler" || arg == "--chunk-size" || arg == "--primality" ||
+                   arg == "--store" || arg == "--kernel") {
+            // Engine settings take the values their config keys take
+            const char* key = (arg == "--scheduler") ? "scheduler" :
+                              (arg == "--chunk-size") ? "chunk_size" :
+                              (arg == "--primality") ? "primality_test" :
+                              (arg == "--store") ? "result_store" : "divisibility_kernel";
+            std::string message;
+            ok = PrimeFinder::parseSetting(key, value, opts.base, message);
+        } else if (arg == "--format") {
+            ok = (value == "csv" || value == "json");
+            opts.format = value;
+        } else if (arg == "--output") {
+            opts.output = value;
+        } else {
+            std::cerr << "Error: unknown option " << arg << "\n";
+            printUsage();
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "Error: invalid value \"" << value << "\" for " << arg << "\n";
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+static double median(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    size_t n = times.size();
+    return (n % 2 == 1) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+}
+
+// Time one search configuration: warmups first, then the trials
+static std::vector<double> timeSearches(const Config& cfg, int warmups, int trials,
+                                        uint64_t& primeCount) {
+    // One finder per case: its engine keeps the pool and base primes warm,
+    // so trials time the search rather than thread start-up
+    PrimeFinder finder(cfg);
+    for (int i = 0; i < warmups; i++) {
+        finder.search();
+    }
+    std::vector<double> times;
+    for (int i = 0; i < trials; i++) {
+        SearchResult run = finder.search();
+        times.push_back(run.seconds);
+        primeCount = run.primeCount;
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+// Time one case, then take median and p95
+BenchmarkCase Benchmark::measure(const std::string& scheme, int threads, int exponent) {
+    Config cfg = options.base;
+    cfg.division_scheme = scheme;
+    cfg.num_threads = threads;
+    cfg.min_number = 1;
+    cfg.max_number = 1ULL << exponent;
+
+    BenchmarkCase result;
+    result.scheme = scheme;
+    result.threads = threads;
+    result.exponent = exponent;
+
+    std::vector<double> times = timeSearches(cfg, options.warmups, options.trials, result.primeCount);
+    size_t n = times.size();
+    result.medianSeconds = median(times);
+    // Nearest-rank percentile
+    size_t rank = static_cast<size_t>(std::ceil(0.95 * n));
+    result.p95Seconds = times[std::max<size_t>(rank, 1) - 1];
+    result.primesPerSecond = result.medianSeconds > 0 ? result.primeCount / result.medianSeconds : 0;
+    return result;
+}
+
+// FEATURE: Padding benchmark (--contention)
+// The engine paths whose per-thread state is cache-line padded, each run at
+// a small chunk size so workers update that state as often as they can:
+// ThreadStats and nextChunk once per chunk, AggregateState once per prime,
+// the CacheAligned result buffers on every push, and DivisibilitySlice for
+// every candidate. The layout is fixed when the binary is built, so compare
+// this report against the one from main-unpadded (-DCACHE_LINE_PADDING=0)
+static const int CONTENTION_CHUNK_SIZE = 64;
+
+struct ContentionPath {
+    const char* name;
+    const char* scheme;
+    const char* scheduler;
+    const char* store;
+};
+
+static const ContentionPath CONTENTION_PATHS[] = {
+    {"dynamic-aggregate", "range", "dynamic", "aggregate"},
+    {"dynamic-vector", "range", "dynamic", "vector"},
+    {"divisibility", "divisibility", "static", "vector"},
+};
+
+ContentionCase Benchmark::measureContention(const ContentionPath& path, int threads, int exponent) {
+    Config cfg = options.base;
+    cfg.division_scheme = path.scheme;
+    cfg.scheduler = path.scheduler;
+    cfg.result_store = path.store;
+    cfg.chunk_size = CONTENTION_CHUNK_SIZE;
+    cfg.num_threads = threads;
+    cfg.min_number = 1;
+    cfg.max_number = 1ULL << exponent;
+
+    ContentionCase result;
+    result.path = path.name;
+    result.layout = CACHE_LINE_PADDING ? "padded" : "packed";
+    result.threads = threads;
+    result.exponent = exponent;
+    result.chunkSize = CONTENTION_CHUNK_SIZE;
+    result.medianSeconds = median(timeSearches(cfg, options.warmups, options.trials,
+                                               result.primeCount));
+    result.numbersPerSecond = result.medianSeconds > 0 ? cfg.max_number / result.medianSeconds : 0;
+    return result;
+}
+
+void Benchmark::writeContention(std::ostream& out) const {
+    if (options.format == "json") {
+        out << "[\n";
+        for (size_t i = 0; i < contentionCases.size(); i++) {
+            const ContentionCase& c = contentionCases[i];
+            out << "    {\"path\": \"" << c.path << "\", \"layout\": \"" << c.layout
+                << "\", \"threads\": " << c.threads << ", \"exponent\": " << c.exponent
+                << ", \"chunk_size\": " << c.chunkSize << ", \"primes\": " << c.primeCount
+                << ", \"median_s\": " << c.medianSeconds
+                << ", \"numbers_per_sec\": " << c.numbersPerSecond << "}"
+                << (i + 1 < contentionCases.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        out << "path,layout,threads,exponent,chunk_size,primes,median_s,numbers_per_sec\n";
+        for (const ContentionCase& c : contentionCases) {
+            out << c.path << "," << c.layout << "," << c.threads << "," << c.exponent << ","
+                << c.chunkSize << "," << c.primeCount << "," << c.medianSeconds << ","
+                << c.numbersPerSecond << "\n";
+        }
+    }
+}
+
+// Speedup of each case against the single-thread run of the same scheme and size
+void Benchmark::computeSpeedups() {
+    std::map<std::pair<std::string, int>, double> singleThread;
+    for (const BenchmarkCase& c : cases) {
+        if (c.threads == 1) singleThread[{c.scheme, c.exponent}] = c.medianSeconds;
+    }
+    for (BenchmarkCase& c : cases) {
+        double base = singleThread[{c.scheme, c.exponent}];
+        c.speedup = c.medianSeconds > 0 ? base / c.medianSeconds : 0;
+    }
+}
+
+void Benchmark::writeCsv(std::ostream& out) const {
+    out << "scheme,threads,exponent,primes,median_s,p95_s,primes_per_sec,speedup\n";
+    for (const BenchmarkCase& c : cases) {
+        out << c.scheme << "," << c.threads << "," << c.exponent << "," << c.primeCount << ","
+            << c.medianSeconds << "," << c.p95Seconds << "," << c.primesPerSecond << ","
+            << c.speedup << "\n";
+    }
+}
+
+void Benchmark::writeJson(std::ostream& out) const {
+    out << "[\n";
+    for (size_t i = 0; i < cases.size(); i++) {
+        const BenchmarkCase& c = cases[i];
+        out << "    {\"scheme\": \"" << c.scheme << "\", \"threads\": " << c.threads
+            << ", \"exponent\": " << c.exponent << ", \"primes\": " << c.primeCount
+            << ", \"median_s\": " << c.medianSeconds << ", \"p95_s\": " << c.p95Seconds
+            << ", \"primes_per_sec\": " << c.primesPerSecond << ", \"speedup\": " << c.speedup
+            << "}" << (i + 1 < cases.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+int Benchmark::run() {
+    cases.clear();
+    contentionCases.clear();
+    int exitCode = 0;
+
+    if (options.contention) {
+        for (int exponent : options.exponents) {
+            for (const ContentionPath& path : CONTENTION_PATHS) {
+                for (int threads : options.threads) {
+                    ContentionCase c = measureContention(path, threads, exponent);
+                    std::cerr << "[bench] " << c.path << " (" << c.layout << ") threads="
+                              << threads << " 2^" << exponent << ": median " << c.medianSeconds
+                              << " s\n";
+                    contentionCases.push_back(c);
+                }
+            }
+        }
+    } else {
+        for (int exponent : options.exponents) {
+            uint64_t expectedCount = 0;
+            for (const std::string& scheme : options.schemes) {
+                for (int threads : options.threads) {
+                    BenchmarkCase c = measure(scheme, threads, exponent);
+                    std::cerr << "[bench] " << scheme << " threads=" << threads << " 2^" << exponent
+                              << ": median " << c.medianSeconds << " s, p95 " << c.p95Seconds
+                              << " s\n";
+
+                    // Every scheme must agree on the count, or the numbers are meaningless
+                    if (expectedCount == 0) expectedCount = c.primeCount;
+                    if (c.primeCount != expectedCount) {
+                        std::cerr << "[bench] Error: " << scheme << " found " << c.primeCount
+                                  << " primes below 2^" << exponent << ", expected "
+                                  << expectedCount << "\n";
+                        exitCode = 1;
+                    }
+                    cases.push_back(c);
+                }
+            }
+        }
+        computeSpeedups();
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open " << options.output << " for writing\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if (options.contention) {
+        writeContention(out);
+    } else if (options.format == "json") {
+        writeJson(out);
+    } else {
+        writeCsv(out);
+    }
+    return exitCode;
+}
@@ -0,0 +1,75 @@
+// Benchmark.h
+// Non-interactive benchmark harness for comparing schemes and thread counts
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include "PrimeFinder.h"
+
+// Settings for one benchmark sweep, filled from the --bench command line
+struct BenchmarkOptions {
+    std::vector<std::string> schemes = {"range", "sieve"};
+    std::vector<int> threads = {1, 2, 4, 8};
+    std::vector<int> exponents = {16, 20};
+    int warmups = 1;             // Untimed runs before each measured case
+    int trials = 5;              // Timed runs per case
+    std::string format = "csv";  // "csv" or "json"
+    std::string output;          // Report file; empty writes to stdout
+    bool contention = false;     // Time the padded engine paths instead
+    Config base;                 // Settings shared by every case
+};
+
+// Timings for one (scheme, threads, exponent) case
+struct BenchmarkCase {
+    std::string scheme;
+    int threads = 0;
+    int exponent = 0;
+    uint64_t primeCount = 0;
+    double medianSeconds = 0;
+    double p95Seconds = 0;
+    double primesPerSecond = 0;
+    double speedup = 0;          // Single-thread median / this median
+};
+
+// One engine path with per-thread padded state, timed in the layout this
+// binary was built with (see CACHE_LINE_PADDING)
+struct ContentionCase {
+    std::string path;            // "dynamic-aggregate", "dynamic-vector" or "divisibility"
+    std::string layout;          // "padded", or "packed" in main-unpadded
+    int threads = 0;
+    int exponent = 0;
+    int chunkSize = 0;
+    uint64_t primeCount = 0;
+    double medianSeconds = 0;
+    double numbersPerSecond = 0;
+};
+
+struct ContentionPath;
+
+class Benchmark {
+private:
+    BenchmarkOptions options;
+    std::vector<BenchmarkCase> cases;
+    std::vector<ContentionCase> contentionCases;
+
+    BenchmarkCase measure(const std::string& scheme, int threads, int exponent);
+    ContentionCase measureContention(const ContentionPath& path, int threads, int exponent);
+    void writeContention(std::ostream& out) const;
+    void computeSpeedups();
+    void writeCsv(std::ostream& out) const;
+    void writeJson(std::ostream& out) const;
+
+public:
+    explicit Benchmark(const BenchmarkOptions& opts);
+
+    // Parses "--bench [--schemes a,b] [--threads 1,2] ..." into options
+    // Returns false and prints usage on bad arguments
+    static bool parseArgs(int argc, char* argv[], BenchmarkOptions& opts);
+
+    // Runs the whole sweep, then writes the report; returns a process exit code
+    int run();
+};
+
+#endif
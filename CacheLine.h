@@ -0,0 +1,47 @@
+// CacheLine.h
+// Cache-line size, and padding that keeps state written by different
+// threads off each other's cache lines (false sharing)
+#ifndef CACHELINE_H
+#define CACHELINE_H
+
+#include <new>
+#include <cstddef>
+
+// Two objects at least this far apart never share a line. GCC warns that
+// the standard constant depends on -mtune; it only sizes in-process layout
+// here, never a file or wire format, so that is fine
+#if defined(__cpp_lib_hardware_interference_size)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+constexpr std::size_t CACHE_LINE_SIZE = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+#endif
+
+// Alignment of state written by different threads. Building with
+// -DCACHE_LINE_PADDING=0 (make main-unpadded) packs it at its natural
+// alignment instead, so main --bench --contention can time the same
+// searches with and without the padding
+#ifndef CACHE_LINE_PADDING
+#define CACHE_LINE_PADDING 1
+#endif
+constexpr std::size_t PADDED_ALIGNMENT = CACHE_LINE_PADDING ? CACHE_LINE_SIZE
+                                                            : alignof(std::max_align_t);
+
+// A T that starts on a cache line and fills whole lines, so nothing else
+// lands next to it. Derives from T to keep its interface:
+// std::vector<CacheAligned<std::vector<uint64_t>>> is a vector of per-thread
+// buffers whose headers no two threads share
+template <typename T>
+struct alignas(PADDED_ALIGNMENT) CacheAligned : T {
+    using T::T;
+    using T::operator=;
+    CacheAligned() = default;
+};
+
+#endif
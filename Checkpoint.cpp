@@ -0,0 +1,104 @@
+#include "Checkpoint.h"
+#include "ResultFile.h"
+#include "PrimeFinder.h"
+#include "SimpleJSON.h"
+#include <sstream>
+#include <cstdio>
+#include <filesystem>
+
+// Read one state value written by saveState()
+static uint64_t stateNumber(const std::string& content, const std::string& key) {
+    uint64_t value;
+    if (!PrimeFinder::parseNumber(SimpleJSON::getValue(content, key), value)) {
+        throw std::runtime_error("Checkpoint state is missing \"" + key + "\"");
+    }
+    return value;
+}
+
+// Opens the checkpoint at path, or starts a new one. An existing checkpoint
+// must be for the same min_number; its data file is cut back to the length
+// the state recorded, dropping a segment that was being appended when the
+// previous run died
+Checkpoint::Checkpoint(const std::string& path, uint64_t lowNumber)
+    : dataPath(path), statePath(path + ".json"), low(lowNumber), next(lowNumber) {
+    std::ifstream state(statePath);
+    if (!state.is_open()) {
+        std::ofstream create(dataPath, std::ios::binary | std::ios::trunc);
+        if (!create.is_open()) throw std::runtime_error("Could not create " + dataPath);
+        create.close();
+        saveState();
+        return;
+    }
+
+    std::stringstream buffer;
+    buffer << state.rdbuf();
+    std::string content = buffer.str();
+    if (stateNumber(content, "min_number") != low) {
+        throw std::runtime_error(dataPath + " was made for min_number " +
+                                 SimpleJSON::getValue(content, "min_number"));
+    }
+    next = stateNumber(content, "next_number");
+    primeCount = stateNumber(content, "prime_count");
+    lastPrime = stateNumber(content, "last_prime");
+    dataBytes = stateNumber(content, "data_bytes");
+
+    std::error_code error;
+    if (std::filesystem::file_size(dataPath, error) < dataBytes || error) {
+        throw std::runtime_error(dataPath + " is shorter than its checkpoint state");
+    }
+    std::filesystem::resize_file(dataPath, dataBytes, error);
+    if (error) throw std::runtime_error("Could not truncate " + dataPath);
+    resumedRun = true;
+}
+
+// Write the state to a temporary file and rename it over the old one, so
+// the state on disk is always either the previous or the new one
+void Checkpoint::saveState() const {
+    std::string tempPath = statePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::trunc);
+    out << "{\n";
+    out << "    \"min_number\": " << low << ",\n";
+    out << "    \"next_number\": " << next << ",\n";
+    out << "    \"prime_count\": " << primeCount << ",\n";
+    out << "    \"last_prime\": " << lastPrime << ",\n";
+    out << "    \"data_bytes\": " << dataBytes << "\n";
+    out << "}\n";
+    out.close();
+    if (!out) throw std::runtime_error("Could not write " + tempPath);
+
+#ifdef _WIN32
+    std::remove(statePath.c_str());  // rename does not replace on Windows
+#endif
+    if (std::rename(tempPath.c_str(), statePath.c_str()) != 0) {
+        throw std::runtime_error("Could not replace " + statePath);
+    }
+}
+
+void Checkpoint::append(const PrimeEngine& engine, uint64_t segmentHigh) {
+    std::vector<uint8_t> encoded;
+    uint64_t found = 0;
+    engine.forEachPrime([&](uint64_t prime) {
+        ResultWriter::appendVarint(prime - lastPrime, encoded);
+        lastPrime = prime;
+        found++;
+    });
+
+    // Data first, state second: a crash in between leaves extra bytes that
+    // the next open truncates away
+    std::ofstream out(dataPath, std::ios::binary | std::ios::app);
+    out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    out.close();
+    if (!out) throw std::runtime_error("Could not append to " + dataPath);
+
+    dataBytes += encoded.size();
+    primeCount += found;
+    next = segmentHigh + 1;
+    saveState();
+}
+
+uint64_t Checkpoint::countUpTo(uint64_t limit) const {
+    if (limit >= lastPrime) return primeCount;
+    uint64_t total = 0;
+    forEachPrime(limit, [&total](uint64_t) { total++; return true; });
+    return total;
+}
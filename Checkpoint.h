@@ -0,0 +1,76 @@
+// Checkpoint.h
+// Resumable searches: primes are appended to a data file segment by
+// segment, and a small JSON state file records how far the search got
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "PrimeEngine.h"
+
+// The data file holds every prime of [low, nextNumber - 1] as LEB128
+// varints of the gap to the previous prime (the first from 0), the same
+// encoding as a varint result file without header or index. The state file
+// (path + ".json") is replaced atomically after each segment, so a run
+// killed at any point resumes after the last segment it recorded
+// Throws std::runtime_error if the files cannot be read or written
+class Checkpoint {
+private:
+    std::string dataPath;
+    std::string statePath;
+    uint64_t low;
+    uint64_t next;                // First number not yet searched
+    uint64_t primeCount = 0;
+    uint64_t lastPrime = 0;
+    uint64_t dataBytes = 0;       // Valid length of the data file
+    bool resumedRun = false;
+
+    void saveState() const;
+
+public:
+    Checkpoint(const std::string& path, uint64_t lowNumber);
+
+    uint64_t nextNumber() const { return next; }
+    uint64_t count() const { return primeCount; }
+    bool resumed() const { return resumedRun; }
+
+    // Appends the primes the engine found in [nextNumber(), segmentHigh]
+    // and records the segment as done
+    void append(const PrimeEngine& engine, uint64_t segmentHigh);
+
+    // Primes in the checkpoint up to limit, which may end before nextNumber()
+    uint64_t countUpTo(uint64_t limit) const;
+
+    // Calls fn for each recorded prime <= limit in ascending order, until fn
+    // returns false
+    template <typename Fn>
+    void forEachPrime(uint64_t limit, Fn fn) const {
+        std::ifstream in(dataPath, std::ios::binary);
+        std::vector<char> chunk(1 << 20);
+        uint64_t prime = 0;
+        uint64_t delta = 0;
+        int shift = 0;
+        uint64_t remaining = dataBytes;
+        while (remaining > 0) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(chunk.size(), remaining));
+            if (!in.read(chunk.data(), want)) throw std::runtime_error("Checkpoint data is truncated");
+            remaining -= want;
+            for (size_t i = 0; i < want; i++) {
+                uint8_t byte = static_cast<uint8_t>(chunk[i]);
+                delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+                if (byte & 0x80) continue;
+                prime += delta;
+                if (prime > limit || !fn(prime)) return;
+                delta = 0;
+                shift = 0;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,655 @@
+#include "Cluster.h"
+#include "PrimeStream.h"
+#include "SimpleJSON.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#endif
+
+static const size_t DATA_CHUNK = 1 << 20;   // Largest DATA payload a worker sends
+
+bool ClusterCoordinator::parseWorkers(const std::string& list, std::vector<std::string>& workers) {
+    workers.clear();
+    std::stringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry = SimpleJSON::trim(entry);
+        if (entry.empty()) continue;
+        size_t colon = entry.rfind(':');
+        if (colon == std::string::npos || colon == 0) return false;
+        std::string port = entry.substr(colon + 1);
+        if (port.empty() || port.size() > 5 || port.find_first_not_of("0123456789") != std::string::npos ||
+            std::stoi(port) == 0 || std::stoi(port) > 65535) {
+            return false;
+        }
+        workers.push_back(entry);
+    }
+    return !workers.empty();
+}
+
+ClusterCoordinator::ClusterCoordinator(const std::vector<std::string>& workers, uint64_t lowNumber,
+                                       uint64_t highNumber, uint64_t shardNumbers,
+                                       const std::string& path, ResultEncoding resultEncoding,
+                                       int timeoutSeconds)
+    : addresses(workers), low(lowNumber), high(highNumber), shardSize(shardNumbers),
+      outputPath(path), encoding(resultEncoding), timeout(timeoutSeconds) {
+    if (addresses.empty() || low > high || shardSize == 0 || timeout <= 0) {
+        throw std::invalid_argument("ClusterCoordinator: needs workers, low <= high, a "
+                                    "positive shard size and a positive timeout");
+    }
+    if (shardCount(low, high, shardSize) > MAX_SHARDS) {
+        throw std::invalid_argument("ClusterCoordinator: more than 2^24 shards; use a larger "
+                                    "shard size");
+    }
+}
+
+#ifdef _WIN32
+
+// Sockets are POSIX only; every entry point fails the same way
+static const char* NO_SOCKETS = "Cluster mode needs POSIX sockets, which this platform lacks";
+
+ClusterWorker::~ClusterWorker() {}
+
+uint16_t ClusterWorker::listen(const std::string&, uint16_t) {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+void ClusterWorker::serve() {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+void ClusterWorker::serve(const std::string&, uint16_t) {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+void ClusterWorker::stop() {}
+
+void ClusterWorker::handle(int) {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+struct ClusterCoordinator::Shard {};
+struct ClusterCoordinator::State {};
+
+ClusterResult ClusterCoordinator::run() {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+void ClusterCoordinator::workerLoop(State&, size_t) {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+uint64_t ClusterCoordinator::merge(State&) {
+    throw std::runtime_error(NO_SOCKETS);
+}
+
+#else
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;   // A vanished peer is an error, not SIGPIPE
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// Buffered reads of protocol lines and DATA payloads from a socket
+class SocketReader {
+private:
+    int fd;
+    char buffer[1 << 16];
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool fill() {
+        ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) timedOut = true;
+        if (received <= 0) return false;
+        begin = 0;
+        end = static_cast<size_t>(received);
+        return true;
+    }
+
+public:
+    explicit SocketReader(int socket) : fd(socket) {}
+
+    // Set when a read failed because the socket's SO_RCVTIMEO expired
+    bool timedOut = false;
+
+    // False once the peer has closed the connection
+    bool readLine(std::string& line) {
+        line.clear();
+        while (true) {
+            if (begin == end && !fill()) return false;
+            const char* start = buffer + begin;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+            if (newline) {
+                line.append(start, newline);
+                begin += newline - start + 1;
+                return true;
+            }
+            line.append(start, end - begin);
+            begin = end;
+            if (line.size() > 4096) return false;   // Not a protocol line
+        }
+    }
+
+    bool read(char* out, size_t size) {
+        while (size > 0) {
+            if (begin == end && !fill()) return false;
+            size_t take = std::min(size, end - begin);
+            std::memcpy(out, buffer + begin, take);
+            begin += take;
+            out += take;
+            size -= take;
+        }
+        return true;
+    }
+};
+
+// Why a read from a worker failed
+static std::runtime_error readFailure(const SocketReader& reader, int timeout) {
+    if (reader.timedOut) {
+        return std::runtime_error("no answer in " + std::to_string(timeout) + " seconds");
+    }
+    return std::runtime_error("connection lost");
+}
+
+static void sendAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = ::send(fd, bytes, size, SEND_FLAGS);
+        if (sent <= 0) throw std::runtime_error("connection lost");
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+static void sendLine(int fd, const std::string& line) {
+    std::string message = line + "\n";
+    sendAll(fd, message.data(), message.size());
+}
+
+// Opens a TCP connection to "host:port"
+static int connectTo(const std::string& address) {
+    size_t colon = address.rfind(':');
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);   // [IPv6]:port
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) {
+        throw std::runtime_error("could not resolve " + address);
+    }
+    int fd = -1;
+    for (addrinfo* candidate = found; candidate; candidate = candidate->ai_next) {
+        fd = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0) break;
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) throw std::runtime_error("could not connect to " + address);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// FEATURE: Cluster worker
+ClusterWorker::~ClusterWorker() {
+    if (listener >= 0) ::close(listener);
+}
+
+uint16_t ClusterWorker::listen(const std::string& host, uint16_t port) {
+    std::string where = host + ":" + std::to_string(port);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+        throw std::runtime_error("could not resolve " + host);
+    }
+    int one = 1;
+    for (addrinfo* candidate = found; candidate; candidate = candidate->ai_next) {
+        listener = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (listener < 0) continue;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(listener, candidate->ai_addr, candidate->ai_addrlen) == 0 &&
+            ::listen(listener, 8) == 0) {
+            break;
+        }
+        ::close(listener);
+        listener = -1;
+    }
+    freeaddrinfo(found);
+    if (listener < 0) throw std::runtime_error("could not listen on " + where);
+
+    sockaddr_storage bound;
+    socklen_t length = sizeof(bound);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &length);
+    return ntohs(bound.ss_family == AF_INET6
+                     ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                     : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+}
+
+void ClusterWorker::serve() {
+    int one = 1;
+    while (!stopping) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        handle(fd);
+        ::close(fd);
+    }
+}
+
+void ClusterWorker::serve(const std::string& host, uint16_t port) {
+    uint16_t bound = listen(host, port);
+    std::cout << "Worker listening on " << host << ":" << bound << " with "
+              << engine.getOptions().num_threads << " threads" << std::endl;
+    serve();
+}
+
+// Shutting the listener down wakes a blocked accept()
+void ClusterWorker::stop() {
+    stopping = true;
+    if (listener >= 0) ::shutdown(listener, SHUT_RDWR);
+}
+
+// Answers one coordinator's SHARD requests until it says BYE or goes away
+void ClusterWorker::handle(int fd) {
+    try {
+        sendLine(fd, "PRIMEWORKER " + std::to_string(CLUSTER_PROTOCOL_VERSION) + " " +
+                     std::to_string(engine.getOptions().num_threads));
+        SocketReader reader(fd);
+        std::string line;
+        std::vector<uint8_t> data;
+        data.reserve(DATA_CHUNK + 16);
+
+        while (reader.readLine(line)) {
+            std::istringstream request(line);
+            std::string command;
+            uint64_t id, shardLow, shardHigh;
+            int wantData;
+            request >> command;
+            if (command == "BYE") return;
+            if (command != "SHARD" || !(request >> id >> shardLow >> shardHigh >> wantData) ||
+                shardLow > shardHigh || shardHigh > PrimeEngine::MAX_NUMBER) {
+                sendLine(fd, "ERROR bad request: " + line);
+                return;
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+            uint64_t count = 0;
+            uint64_t previous = 0;
+            auto sendData = [&]() {
+                sendLine(fd, "DATA " + std::to_string(data.size()));
+                sendAll(fd, data.data(), data.size());
+                data.clear();
+            };
+            try {
+                PrimeStream stream(engine, shardLow, shardHigh);
+                uint64_t prime;
+                while (stream.next(prime)) {
+                    count++;
+                    if (!wantData) continue;
+                    ResultWriter::appendVarint(prime - previous, data);
+                    previous = prime;
+                    if (data.size() >= DATA_CHUNK) sendData();
+                }
+            } catch (const std::invalid_argument& e) {
+                sendLine(fd, std::string("ERROR ") + e.what());
+                return;
+            }
+            if (!data.empty()) sendData();
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            std::ostringstream done;
+            done << "DONE " << id << " " << count << " " << elapsed.count();
+            sendLine(fd, done.str());
+            if (logShards) {
+                std::cout << "  - Shard " << id << " [" << shardLow << ", " << shardHigh << "]: "
+                          << count << " primes in " << elapsed.count() << " seconds" << std::endl;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Worker: " << e.what() << std::endl;
+    }
+}
+
+// FEATURE: Cluster coordinator
+struct ClusterCoordinator::Shard {
+    uint64_t low;
+    uint64_t high;
+    bool done = false;
+    int running = 0;              // Attempts in flight
+    int attempts = 0;
+    std::chrono::steady_clock::time_point started;   // Of the latest attempt
+    uint64_t count = 0;
+    std::string dataPath;         // Primes of the attempt that won
+};
+
+// Shared by the per-worker threads, guarded by mtx
+struct ClusterCoordinator::State {
+    std::vector<Shard> shards;
+    std::mutex mtx;
+    std::condition_variable changed;
+    size_t doneCount = 0;
+    double doneSeconds = 0;       // Wall time of the finished shards
+    size_t alive = 0;             // Worker threads still connected
+    bool finished = false;        // Every shard is done, late answers are dropped
+    std::vector<int> sockets;     // Per worker, -1 when not connected
+    std::vector<size_t> current;  // Per worker, the shard it is running or npos
+    ClusterResult result;
+
+    // Next shard for an idle worker: a queued one, else the longest
+    // running straggler with no duplicate yet; npos if there is none
+    size_t pick() {
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (!shards[i].done && shards[i].running == 0) return i;
+        }
+        if (doneCount == 0) return std::string::npos;
+        double limit = STRAGGLER_FACTOR * doneSeconds / doneCount;
+        auto now = std::chrono::steady_clock::now();
+        size_t best = std::string::npos;
+        for (size_t i = 0; i < shards.size(); i++) {
+            const Shard& shard = shards[i];
+            if (shard.done || shard.running != 1) continue;
+            std::chrono::duration<double> running = now - shard.started;
+            if (running.count() > limit &&
+                (best == std::string::npos || shard.started < shards[best].started)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+// Follows a shard's varint stream as its DATA payloads arrive, so what the
+// worker sent can be checked against its DONE count before it is accepted
+struct ShardDecoder {
+    uint64_t low;
+    uint64_t high;
+    uint64_t prime = 0;       // Last prime decoded
+    uint64_t delta = 0;       // Varint being decoded
+    int shift = 0;
+    uint64_t count = 0;
+
+    // Throws std::runtime_error on a prime out of order or outside the shard
+    void feed(const char* bytes, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            uint8_t byte = static_cast<uint8_t>(bytes[i]);
+            if (shift > 63) throw std::runtime_error("corrupt DATA");
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+            if (byte & 0x80) continue;
+            if (delta == 0 || delta > high - prime || prime + delta < low) {
+                throw std::runtime_error("DATA holds a prime outside the shard");
+            }
+            prime += delta;
+            count++;
+            delta = 0;
+            shift = 0;
+        }
+    }
+
+    // True if the stream does not end inside a varint
+    bool complete() const { return shift == 0; }
+};
+
+// One thread per worker: connect, then run shards until none are left.
+// A shard whose DATA does not add up to the DONE count is dropped with the
+// connection, which is no longer in step, and goes back in the queue
+void ClusterCoordinator::workerLoop(State& state, size_t index) {
+    const size_t none = std::string::npos;
+    std::string path;
+    int fd = -1;
+    try {
+        fd = connectTo(addresses[index]);
+        {
+            std::lock_guard<std::mutex> lock(state.mtx);
+            state.sockets[index] = fd;
+        }
+        // Every read gives up after timeout seconds of silence
+        timeval limit;
+        limit.tv_sec = timeout;
+        limit.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+        SocketReader reader(fd);
+        std::string line;
+        if (!reader.readLine(line)) throw readFailure(reader, timeout);
+        std::istringstream greeting(line);
+        std::string magic;
+        int version = 0, threads = 0;
+        greeting >> magic >> version >> threads;
+        if (magic != "PRIMEWORKER" || version != CLUSTER_PROTOCOL_VERSION) {
+            throw std::runtime_error("not a prime worker of protocol version " +
+                                     std::to_string(CLUSTER_PROTOCOL_VERSION));
+        }
+
+        std::vector<char> payload;
+        while (true) {
+            size_t id = none;
+            uint64_t shardLow = 0, shardHigh = 0;
+            {
+                std::unique_lock<std::mutex> lock(state.mtx);
+                state.result.workers[index].threads = threads;
+                while (true) {
+                    if (state.doneCount == state.shards.size()) break;
+                    id = state.pick();
+                    if (id != none) break;
+                    state.changed.wait_for(lock, std::chrono::milliseconds(250));
+                }
+                if (state.doneCount == state.shards.size()) break;
+
+                Shard& shard = state.shards[id];
+                if (shard.attempts > 0) {
+                    if (shard.running > 0) {
+                        state.result.duplicates++;
+                    } else {
+                        state.result.retries++;
+                    }
+                }
+                shard.running++;
+                shard.attempts++;
+                shard.started = std::chrono::steady_clock::now();
+                state.current[index] = id;
+                shardLow = shard.low;
+                shardHigh = shard.high;
+            }
+
+            std::ofstream data;
+            if (!outputPath.empty()) {
+                path = outputPath + ".shard" + std::to_string(id) + "." + std::to_string(index);
+                data.open(path, std::ios::binary | std::ios::trunc);
+                if (!data.is_open()) throw std::runtime_error("could not create " + path);
+            }
+            sendLine(fd, "SHARD " + std::to_string(id) + " " + std::to_string(shardLow) + " " +
+                         std::to_string(shardHigh) + (outputPath.empty() ? " 0" : " 1"));
+
+            uint64_t count = 0;
+            double seconds = 0;
+            ShardDecoder decoder{shardLow, shardHigh};
+            while (true) {
+                if (!reader.readLine(line)) throw readFailure(reader, timeout);
+                std::istringstream reply(line);
+                std::string kind;
+                reply >> kind;
+                if (kind == "DATA") {
+                    size_t size = 0;
+                    reply >> size;
+                    if (size > DATA_CHUNK * 2) throw std::runtime_error("oversized DATA");
+                    payload.resize(size);
+                    if (!reader.read(payload.data(), size)) throw readFailure(reader, timeout);
+                    decoder.feed(payload.data(), size);
+                    data.write(payload.data(), static_cast<std::streamsize>(size));
+                } else if (kind == "DONE") {
+                    size_t doneId = none;
+                    if (!(reply >> doneId >> count >> seconds)) {
+                        throw std::runtime_error("bad answer: " + line);
+                    }
+                    if (doneId != id) throw std::runtime_error("answer for the wrong shard");
+                    // Count-only shards carry no DATA to check against
+                    if (!outputPath.empty() && (!decoder.complete() || decoder.count != count)) {
+                        throw std::runtime_error("shard " + std::to_string(id) + " reported " +
+                                                 std::to_string(count) + " primes but sent " +
+                                                 std::to_string(decoder.count));
+                    }
+                    break;
+                } else {
+                    throw std::runtime_error("worker said: " + line);
+                }
+            }
+            data.close();
+            if (!outputPath.empty() && !data) throw std::runtime_error("could not write " + path);
+
+            std::lock_guard<std::mutex> lock(state.mtx);
+            Shard& shard = state.shards[id];
+            shard.running--;
+            state.current[index] = none;
+            if (!shard.done) {
+                std::chrono::duration<double> wall = std::chrono::steady_clock::now() - shard.started;
+                shard.done = true;
+                shard.count = count;
+                shard.dataPath = path;
+                state.doneCount++;
+                state.doneSeconds += wall.count();
+                state.result.workers[index].shards++;
+                state.result.workers[index].busySeconds += seconds;
+            } else if (!path.empty()) {
+                std::remove(path.c_str());   // A faster duplicate already answered
+            }
+            path.clear();
+            state.changed.notify_all();
+        }
+        sendLine(fd, "BYE");
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(state.mtx);
+        size_t id = state.current[index];
+        if (id != none) {
+            state.shards[id].running--;   // Back in the queue unless another attempt runs
+            state.current[index] = none;
+        }
+        if (!path.empty()) std::remove(path.c_str());
+        if (!state.finished) {
+            state.result.workers[index].failed = true;
+            std::cerr << "Worker " << addresses[index] << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(state.mtx);
+    state.sockets[index] = -1;
+    if (fd >= 0) ::close(fd);
+    state.alive--;
+    state.changed.notify_all();
+}
+
+// Concatenates the shards' primes, in order, into the result file
+uint64_t ClusterCoordinator::merge(State& state) {
+    ResultWriter writer(outputPath, encoding, low, high);
+    std::vector<char> chunk(1 << 20);
+    for (const Shard& shard : state.shards) {
+        std::ifstream in(shard.dataPath, std::ios::binary);
+        if (!in.is_open()) throw std::runtime_error("missing shard file " + shard.dataPath);
+        uint64_t prime = 0, delta = 0;
+        int shift = 0;
+        while (in) {
+            in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            std::streamsize got = in.gcount();
+            for (std::streamsize i = 0; i < got; i++) {
+                uint8_t byte = static_cast<uint8_t>(chunk[i]);
+                delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+                if (byte & 0x80) continue;
+                prime += delta;
+                writer.add(prime);
+                delta = 0;
+                shift = 0;
+            }
+        }
+        in.close();
+        std::remove(shard.dataPath.c_str());
+    }
+    return writer.finish();
+}
+
+ClusterResult ClusterCoordinator::run() {
+    auto startTime = std::chrono::steady_clock::now();
+    State state;
+    for (uint64_t shardLow = low; ; shardLow += shardSize) {
+        Shard shard;
+        shard.low = shardLow;
+        shard.high = (high - shardLow < shardSize) ? high : shardLow + shardSize - 1;
+        state.shards.push_back(shard);
+        if (shard.high == high) break;
+    }
+    state.alive = addresses.size();
+    state.sockets.assign(addresses.size(), -1);
+    state.current.assign(addresses.size(), std::string::npos);
+    state.result.workers.resize(addresses.size());
+    for (size_t i = 0; i < addresses.size(); i++) state.result.workers[i].address = addresses[i];
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        threads.emplace_back(&ClusterCoordinator::workerLoop, this, std::ref(state), i);
+    }
+    {
+        // Once every shard is in, cut off workers still running duplicates
+        std::unique_lock<std::mutex> lock(state.mtx);
+        state.changed.wait(lock, [&] {
+            return state.doneCount == state.shards.size() || state.alive == 0;
+        });
+        state.finished = true;
+        for (size_t i = 0; i < addresses.size(); i++) {
+            if (state.sockets[i] >= 0 && state.current[i] != std::string::npos) {
+                ::shutdown(state.sockets[i], SHUT_RDWR);
+            }
+        }
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    if (state.doneCount < state.shards.size()) {
+        for (const Shard& shard : state.shards) {
+            if (!shard.dataPath.empty()) std::remove(shard.dataPath.c_str());
+        }
+        throw std::runtime_error("every worker failed, " +
+                                 std::to_string(state.shards.size() - state.doneCount) +
+                                 " of " + std::to_string(state.shards.size()) + " shards unfinished");
+    }
+
+    ClusterResult result = state.result;
+    result.shards = state.shards.size();
+    for (const Shard& shard : state.shards) result.primeCount += shard.count;
+    if (!outputPath.empty()) result.fileBytes = merge(state);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+#endif
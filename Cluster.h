@@ -0,0 +1,133 @@
+// Cluster.h
+// Distributed searches: a coordinator shards the search window over worker
+// processes on other hosts, each running "main --serve PORT"
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include "PrimeEngine.h"
+#include "ResultFile.h"
+
+// Line-based protocol over one TCP connection per worker:
+//   worker:      PRIMEWORKER 1 <threads>              on connect
+//   coordinator: SHARD <id> <low> <high> <data>       data 1 to receive the primes
+//   worker:      DATA <n>, then n bytes               zero or more times
+//                DONE <id> <count> <seconds>          or ERROR <message>
+//   coordinator: BYE
+// DATA carries the shard's primes as LEB128 varints of the gap to the
+// previous prime (the first from 0), the encoding of checkpoint data files.
+// Workers always sieve, streaming each shard in order through PrimeStream
+// so their memory stays bounded whatever the shard size
+static const int CLUSTER_PROTOCOL_VERSION = 1;
+
+// Serves shards on a port with the caller's long-lived engine, so the pool
+// and base primes carry over from shard to shard and coordinator to
+// coordinator. The protocol has no authentication: anyone who can reach
+// the port can make the worker search, so it only listens on loopback
+// unless told otherwise. Shards above PrimeEngine::MAX_NUMBER are refused.
+// Throws std::runtime_error if the address cannot be opened
+class ClusterWorker {
+private:
+    PrimeEngine& engine;
+    bool logShards;                   // Print a line per finished shard
+    int listener = -1;
+    std::atomic<bool> stopping{false};
+
+    void handle(int fd);
+
+public:
+    explicit ClusterWorker(PrimeEngine& searchEngine, bool logEachShard = true)
+        : engine(searchEngine), logShards(logEachShard) {}
+    ~ClusterWorker();
+
+    ClusterWorker(const ClusterWorker&) = delete;
+    ClusterWorker& operator=(const ClusterWorker&) = delete;
+
+    // Address the worker binds unless given one
+    static constexpr const char* DEFAULT_BIND_ADDRESS = "127.0.0.1";
+
+    // Binds host:port, where host may be a name, an IPv4 or an IPv6
+    // address and port 0 picks a free port; returns the port bound
+    uint16_t listen(const std::string& host, uint16_t port);
+
+    // Accepts coordinators on the bound port, one at a time, until stop()
+    void serve();
+
+    // listen(), then serve() until the process is killed
+    void serve(const std::string& host, uint16_t port);
+
+    // Makes serve() return once the coordinator it is answering, if any, is done
+    void stop();
+};
+
+// One worker as the coordinator saw it
+struct ClusterWorkerStats {
+    std::string address;
+    int threads = 0;              // As the worker reported
+    uint64_t shards = 0;          // Shards whose result was used
+    double busySeconds = 0;       // Worker-side search time of those shards
+    bool failed = false;          // Dropped after a connection or protocol error
+};
+
+// Outcome of a distributed search
+struct ClusterResult {
+    uint64_t primeCount = 0;
+    double seconds = 0;
+    uint64_t shards = 0;
+    uint64_t retries = 0;         // Shards sent again after their worker failed
+    uint64_t duplicates = 0;      // Straggler shards that were also run elsewhere
+    uint64_t fileBytes = 0;       // Size of the merged result file, if any
+    std::vector<ClusterWorkerStats> workers;
+};
+
+// Splits [low, high] into shards of shardSize numbers and hands them to
+// the workers, one at a time per worker. A shard whose worker fails is
+// queued again; once the queue is empty, idle workers also take
+// stragglers (shards running far longer than the average) and the first
+// answer wins. With an output path the shards' primes are collected in
+// temporary files next to it and merged in order into one result file.
+// A worker silent for timeoutSeconds, hung or behind a half-open
+// connection, is dropped like one that failed and its shard is queued again.
+// Throws std::invalid_argument for more than MAX_SHARDS shards, and
+// std::runtime_error if every worker fails before the end
+class ClusterCoordinator {
+public:
+    // A straggler runs this many times longer than the mean shard
+    static constexpr double STRAGGLER_FACTOR = 3.0;
+    // Shards a window may be split into; the shard table is allocated up front
+    static const uint64_t MAX_SHARDS = 1ULL << 24;
+
+    ClusterCoordinator(const std::vector<std::string>& workers, uint64_t low, uint64_t high,
+                       uint64_t shardSize, const std::string& outputPath,
+                       ResultEncoding encoding, int timeoutSeconds);
+
+    // Shards [low, high] splits into at shardSize numbers each
+    static uint64_t shardCount(uint64_t low, uint64_t high, uint64_t shardSize) {
+        return (high - low) / shardSize + 1;
+    }
+
+    ClusterResult run();
+
+    // Parses "host:port,host:port"; false if any entry is malformed
+    static bool parseWorkers(const std::string& list, std::vector<std::string>& workers);
+
+private:
+    struct Shard;
+    struct State;
+
+    std::vector<std::string> addresses;
+    uint64_t low;
+    uint64_t high;
+    uint64_t shardSize;
+    std::string outputPath;
+    ResultEncoding encoding;
+    int timeout;                      // Seconds a worker may stay silent
+
+    void workerLoop(State& state, size_t index);
+    uint64_t merge(State& state);
+};
+
+#endif
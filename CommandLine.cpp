@@ -0,0 +1,123 @@
+#include "CommandLine.h"
+#include <iostream>
+
+void CommandLine::printUsage(std::ostream& out) {
+    out << "Usage: main [options]\n"
+        << "       main --bench [benchmark options]\n"
+        << "       main --query FILE info | count [A B] | nth K | range A B\n"
+        << "       main --serve [ADDRESS:]PORT [options]   run as a cluster worker\n"
+        << "With no options the program asks for settings interactively.\n"
+        << "Any option runs headless: no prompts and no screen clearing.\n"
+        << "  --config FILE       read settings from FILE (default config.json)\n"
+        << "  --no-config         ignore config files, start from built-in defaults\n"
+        << "  --headless          run config.json as is, without prompts\n"
+        << "  --threads N         number of threads\n"
+        << "  --min N             lowest number to search (\"2^X\" or integer)\n"
+        << "  --max N             highest number to search (\"2^X\" or integer)\n"
+        << "  --scheme NAME       range, divisibility, sieve or auto (calibrate and save)\n"
+        << "  --print-mode NAME   immediate, wait, stream or pipeline\n"
+        << "  --scheduler NAME    static or dynamic\n"
+        << "  --chunk-size N      chunk size for the dynamic scheduler\n"
+        << "  --primality NAME    trial or miller_rabin\n"
+        << "  --store NAME        vector, bitmap or aggregate (count, sum, twins, largest)\n"
+        << "  --kernel NAME       auto, scalar, avx2, avx512 or neon\n"
+        << "  --output FILE       also write the primes to FILE in binary\n"
+        << "  --output-format NAME  varint or bitmap\n"
+        << "  --checkpoint FILE   save progress to FILE, resume or extend from it\n"
+        << "  --checkpoint-interval N  numbers searched between checkpoints\n"
+        << "  --encoders N        pipeline mode: threads formatting the output (default 1)\n"
+        << "  --cache DIR         reuse primes of earlier runs kept in DIR, add new ones\n"
+        << "  --test LIST         only test these comma-separated numbers\n"
+        << "  --affinity NAME     none, compact or spread (pin workers over NUMA nodes)\n"
+        << "  --workers LIST      shard the search over host:port,... cluster workers\n"
+        << "  --shard-size N      numbers per cluster shard (default 2^32)\n"
+        << "  --shard-timeout N   seconds a worker may stay silent before its shard is\n"
+        << "                      sent elsewhere (default 600)\n"
+        << "  --metrics on|off    print per-thread counters after the search\n"
+        << "  --trace FILE        write a Chrome trace of the search to FILE\n"
+        << "  --help              show this message\n";
+}
+
+bool CommandLine::parse(int argc, char* argv[]) {
+    // Flags that take a value, and the config key each one overrides
+    static const std::pair<const char*, const char*> valueFlags[] = {
+        {"--threads", "num_threads"},
+        {"--min", "min_number"},
+        {"--max", "max_number"},
+        {"--scheme", "division_scheme"},
+        {"--print-mode", "print_mode"},
+        {"--scheduler", "scheduler"},
+        {"--chunk-size", "chunk_size"},
+        {"--primality", "primality_test"},
+        {"--store", "result_store"},
+        {"--kernel", "divisibility_kernel"},
+        {"--output", "output_file"},
+        {"--output-format", "output_format"},
+        {"--checkpoint", "checkpoint_file"},
+        {"--checkpoint-interval", "checkpoint_interval"},
+        {"--cache", "cache_dir"},
+        {"--encoders", "encode_threads"},
+        {"--test", "test_numbers"},
+        {"--affinity", "affinity"},
+        {"--workers", "cluster_workers"},
+        {"--shard-size", "shard_size"},
+        {"--shard-timeout", "shard_timeout"},
+        {"--metrics", "metrics"},
+        {"--trace", "trace_file"},
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        headless = true;
+
+        if (arg == "--help" || arg == "-h") {
+            showHelp = true;
+            continue;
+        }
+        if (arg == "--headless") continue;
+        if (arg == "--no-config") {
+            useConfigFile = false;
+            continue;
+        }
+
+        const char* key = nullptr;
+        if (arg != "--config") {
+            for (const auto& flag : valueFlags) {
+                if (arg == flag.first) key = flag.second;
+            }
+            if (key == nullptr) {
+                std::cerr << "Error: unknown option " << arg << "\n";
+                printUsage(std::cerr);
+                return false;
+            }
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << arg << " needs a value\n";
+            printUsage(std::cerr);
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (key == nullptr) {
+            configFile = value;
+        } else {
+            overrides.push_back({key, value});
+        }
+    }
+    return true;
+}
+
+// Each value goes through the config parser's own rules, so a flag accepts
+// exactly what the same key accepts in a config file. The search window and
+// mode conflicts are left to PrimeFinder::validate
+bool CommandLine::apply(Config& cfg) const {
+    for (const auto& entry : overrides) {
+        std::string message;
+        if (!PrimeFinder::parseSetting(entry.first, entry.second, cfg, message)) {
+            std::cerr << "Error: invalid value \"" << entry.second << "\": " << message << "\n";
+            return false;
+        }
+    }
+    return true;
+}
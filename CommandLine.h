@@ -0,0 +1,34 @@
+// CommandLine.h
+// Command-line flags for headless runs that skip the interactive prompts
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include <utility>
+#include "PrimeFinder.h"
+
+class CommandLine {
+private:
+    // (config key, value) pairs in the order they were given
+    std::vector<std::pair<std::string, std::string>> overrides;
+
+public:
+    bool headless = false;       // Any flag given: no prompts, no screen clearing
+    bool showHelp = false;
+    bool useConfigFile = true;   // False with --no-config: start from built-in defaults
+    std::string configFile = "config.json";
+
+    // Parses argv; prints an error and returns false on a bad flag
+    bool parse(int argc, char* argv[]);
+
+    // Applies the overrides on top of cfg, validating each value as the
+    // config file would; prints an error and returns false on a bad one
+    bool apply(Config& cfg) const;
+
+    // To stdout for --help, to stderr after a parse error
+    static void printUsage(std::ostream& out);
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef DIVISIBILITYKERNEL_H
+#define DIVISIBILITYKERNEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DIVISIBILITY_KERNEL_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define DIVISIBILITY_KERNEL_NEON 1
+#endif
+
+// Tests one number against a run of 32-bit divisors at once
+// The vector kernels compute q = round(n / d) in double precision and check
+// q * d == n. Both products are exact integers below 2^53, so the test is
+// exact as long as n < 2^52; larger numbers always take the scalar path.
+// The kernel is picked once at run time from what the CPU supports
+class DivisibilityKernel {
+public:
+    // Largest number the vector kernels handle exactly
+    static const uint64_t VECTOR_LIMIT = 1ULL << 52;
+
+    enum Kind { SCALAR, AVX2, AVX512, NEON };
+
+    // Scalar reference: index of the first of the count divisors that
+    // divides n, or count if none does
+    static size_t findDivisorScalar(uint64_t n, const uint32_t* divisors, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (n % divisors[i] == 0) return i;
+        }
+        return count;
+    }
+
+    static bool supported(Kind kind) {
+        switch (kind) {
+        case SCALAR:
+            return true;
+#if defined(DIVISIBILITY_KERNEL_X86) && defined(__GNUC__)
+        case AVX2:
+            return __builtin_cpu_supports("avx2");
+        case AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(DIVISIBILITY_KERNEL_NEON)
+        case NEON:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    // Map a config name ("auto", "scalar", "avx2", "avx512", "neon") to a
+    // kernel this CPU runs; an unsupported request falls back to the best
+    // supported one
+    static Kind select(const std::string& name) {
+        if (name == "scalar") return SCALAR;
+        if (name == "avx2" && supported(AVX2)) return AVX2;
+        if (name == "avx512" && supported(AVX512)) return AVX512;
+        if (name == "neon" && supported(NEON)) return NEON;
+        if (supported(AVX512)) return AVX512;
+        if (supported(AVX2)) return AVX2;
+        if (supported(NEON)) return NEON;
+        return SCALAR;
+    }
+
+    static const char* name(Kind kind) {
+        switch (kind) {
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+        case NEON: return "neon";
+        default: return "scalar";
+        }
+    }
+
+    // Index of the first of the count divisors that divides n, or count if
+    // none does, using the given kernel; the index + 1 is the number of
+    // divisions performed. Divisors must be at least 2 and below 2^31
+    static size_t findDivisor(Kind kind, uint64_t n, const uint32_t* divisors, size_t count) {
+        if (n >= VECTOR_LIMIT) return findDivisorScalar(n, divisors, count);
+        switch (kind) {
+#if defined(DIVISIBILITY_KERNEL_X86) && defined(__GNUC__)
+        case AVX2:
+            return findDivisorAvx2(n, divisors, count);
+        case AVX512:
+            return findDivisorAvx512(n, divisors, count);
+#endif
+#if defined(DIVISIBILITY_KERNEL_NEON)
+        case NEON:
+            return findDivisorNeon(n, divisors, count);
+#endif
+        default:
+            return findDivisorScalar(n, divisors, count);
+        }
+    }
+
+private:
+#if defined(DIVISIBILITY_KERNEL_X86) && defined(__GNUC__)
+    // 4 divisors per step
+    __attribute__((target("avx2")))
+    static size_t findDivisorAvx2(uint64_t n, const uint32_t* divisors, size_t count) {
+        const __m256d value = _mm256_set1_pd(static_cast<double>(n));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(divisors + i));
+            __m256d d = _mm256_cvtepi32_pd(raw);
+            __m256d q = _mm256_round_pd(_mm256_div_pd(value, d),
+                                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m256d hit = _mm256_cmp_pd(_mm256_mul_pd(q, d), value, _CMP_EQ_OQ);
+            int mask = _mm256_movemask_pd(hit);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        return i + findDivisorScalar(n, divisors + i, count - i);
+    }
+
+    // 8 divisors per step
+    __attribute__((target("avx512f")))
+    static size_t findDivisorAvx512(uint64_t n, const uint32_t* divisors, size_t count) {
+        const __m512d value = _mm512_set1_pd(static_cast<double>(n));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(divisors + i));
+            // Zero-masked forms with a full mask: same result, but GCC's unmasked
+            // wrappers trip -Wmaybe-uninitialized on their undefined source
+            __m512d d = _mm512_maskz_cvtepu32_pd(0xFF, raw);
+            __m512d q = _mm512_maskz_roundscale_pd(0xFF, _mm512_div_pd(value, d),
+                                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __mmask8 mask = _mm512_cmp_pd_mask(_mm512_mul_pd(q, d), value, _CMP_EQ_OQ);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        return i + findDivisorScalar(n, divisors + i, count - i);
+    }
+#endif
+
+#if defined(DIVISIBILITY_KERNEL_NEON)
+    // 2 divisors per step
+    static size_t findDivisorNeon(uint64_t n, const uint32_t* divisors, size_t count) {
+        const float64x2_t value = vdupq_n_f64(static_cast<double>(n));
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            uint64x2_t wide = vmovl_u32(vld1_u32(divisors + i));
+            float64x2_t d = vcvtq_f64_u64(wide);
+            float64x2_t q = vrndnq_f64(vdivq_f64(value, d));
+            uint64x2_t hit = vceqq_f64(vmulq_f64(q, d), value);
+            if (vgetq_lane_u64(hit, 0)) return i;
+            if (vgetq_lane_u64(hit, 1)) return i + 1;
+        }
+        return i + findDivisorScalar(n, divisors + i, count - i);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "Pipeline.h"
+#include "Wheel.h"
+#include "SmallPrimes.h"
+#include <thread>
+#include <chrono>
+#include <charconv>
+#include <stdexcept>
+#include <algorithm>
+
+typedef std::chrono::steady_clock PipelineClock;
+
+static double secondsSince(PipelineClock::time_point start) {
+    std::chrono::duration<double> elapsed = PipelineClock::now() - start;
+    return elapsed.count();
+}
+
+// Batches in the pool: POOL_PER_THREAD for every thread of every stage.
+// Each queue can hold all of them, so only the free queue ever blocks
+size_t PrimePipeline::poolSize(const PrimeEngine& engine, int encoders) {
+    return POOL_PER_THREAD * static_cast<size_t>(engine.pool->size() + std::max(encoders, 1) + 2);
+}
+
+// Allocates the batch pool and fills the free queue; nothing runs yet
+PrimePipeline::PrimePipeline(PrimeEngine& searchEngine, uint64_t lowNumber, uint64_t highNumber,
+                             int encoderThreads)
+    : engine(searchEngine), low(lowNumber), high(highNumber), encoders(encoderThreads),
+      freeBatches(poolSize(searchEngine, encoderThreads)),
+      toTest(poolSize(searchEngine, encoderThreads)),
+      toEncode(poolSize(searchEngine, encoderThreads)),
+      toOutput(poolSize(searchEngine, encoderThreads)) {
+    if (low > high || high > PrimeEngine::MAX_NUMBER || encoders <= 0) {
+        throw std::invalid_argument("PrimePipeline: low must not exceed high, high must not "
+                                    "exceed 2^63, encoders must be positive");
+    }
+    for (size_t i = 0; i < poolSize(engine, encoders); i++) {
+        batches.emplace_back(new Batch());
+        batches.back()->numbers.reserve(BATCH_NUMBERS / 210 * 48 + 52);
+        freeBatches.push(batches.back().get());
+    }
+    stages = {{"generate", 1}, {"test", engine.pool->size()}, {"encode", encoders},
+              {"output", 1}};
+}
+
+void PrimePipeline::addStats(size_t stage, uint64_t batchCount, double busy, double wait) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stages[stage].batches += batchCount;
+    stages[stage].busySeconds += busy;
+    stages[stage].waitSeconds += wait;
+}
+
+// Same test as the range scheme: the compile-time table below 2^16, the
+// base primes past the wheel primes when trial dividing, else the backend
+bool PrimePipeline::isPrime(uint64_t n, bool useTable) const {
+    if (n < SmallPrimes::LIMIT) return SmallPrimes::isPrime(n);
+    if (useTable) return engine.isPrimeBasePrimes(n, PrimeEngine::WHEEL_PRIMES);
+    return engine.isPrime(n);
+}
+
+// STAGE 1: Lists the wheel candidates of each batch, plus the wheel primes
+// themselves, which the wheel skips
+void PrimePipeline::generate() {
+    uint64_t produced = 0;
+    double busy = 0, wait = 0;
+    for (uint64_t start = low; ; start += BATCH_NUMBERS) {
+        auto waitStart = PipelineClock::now();
+        BatchPtr batch = nullptr;
+        freeBatches.pop(batch);
+        wait += secondsSince(waitStart);
+        if (cancelled.load(std::memory_order_relaxed)) break;
+
+        auto busyStart = PipelineClock::now();
+        batch->sequence = produced++;
+        batch->low = start;
+        batch->high = (high - start < BATCH_NUMBERS) ? high : start + BATCH_NUMBERS - 1;
+        batch->numbers.clear();
+        for (uint64_t p : {2, 3, 5, 7}) {
+            if (p >= batch->low && p <= batch->high) batch->numbers.push_back(p);
+        }
+        for (uint64_t num : Wheel<210>::candidates(batch->low, batch->high)) {
+            batch->numbers.push_back(num);
+        }
+        busy += secondsSince(busyStart);
+        bool last = (batch->high == high);
+        toTest.push(batch);
+        if (last) break;
+    }
+    toTest.close();
+    addStats(0, produced, busy, wait);
+}
+
+// STAGE 2: Keeps the primes of each batch, in place and in order
+void PrimePipeline::test() {
+    bool useTable = (engine.getOptions().primality_test != "miller_rabin");
+    uint64_t tested = 0;
+    double busy = 0, wait = 0;
+    while (true) {
+        auto waitStart = PipelineClock::now();
+        BatchPtr batch = nullptr;
+        bool got = toTest.pop(batch);
+        wait += secondsSince(waitStart);
+        if (!got) break;
+
+        auto busyStart = PipelineClock::now();
+        size_t kept = 0;
+        for (uint64_t num : batch->numbers) {
+            if (isPrime(num, useTable)) batch->numbers[kept++] = num;
+        }
+        batch->numbers.resize(kept);
+        busy += secondsSince(busyStart);
+        tested++;
+        toEncode.push(batch);
+    }
+    addStats(1, tested, busy, wait);
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (--testersLeft == 0) toEncode.close();
+}
+
+// STAGE 3: Formats the primes of each batch as the wait-mode listing does
+void PrimePipeline::encode() {
+    uint64_t encoded = 0;
+    double busy = 0, wait = 0;
+    char digits[24];
+    while (true) {
+        auto waitStart = PipelineClock::now();
+        BatchPtr batch = nullptr;
+        bool got = toEncode.pop(batch);
+        wait += secondsSince(waitStart);
+        if (!got) break;
+
+        auto busyStart = PipelineClock::now();
+        batch->text.clear();
+        for (uint64_t prime : batch->numbers) {
+            char* end = std::to_chars(digits, digits + sizeof(digits), prime).ptr;
+            batch->text.append("Prime: ");
+            batch->text.append(digits, end);
+            batch->text.push_back('\n');
+        }
+        busy += secondsSince(busyStart);
+        encoded++;
+        toOutput.push(batch);
+    }
+    addStats(2, encoded, busy, wait);
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (--encodersLeft == 0) toOutput.close();
+}
+
+// STAGE 4, on the calling thread: hands batches to the sink in sequence
+// order and returns them to the free pool. A batch that arrives early waits
+// in its slot; there are never more of those than batches in the pool
+uint64_t PrimePipeline::run(const Sink& sink) {
+    engine.computeBasePrimes(static_cast<uint32_t>(PrimeEngine::isqrt(high)));
+    testersLeft = engine.pool->size();
+    encodersLeft = encoders;
+
+    std::thread generator(&PrimePipeline::generate, this);
+    for (int i = 0; i < engine.pool->size(); i++) {
+        engine.pool->submit([this] { test(); });
+    }
+    std::vector<std::thread> encoderThreads;
+    for (int i = 0; i < encoders; i++) encoderThreads.emplace_back(&PrimePipeline::encode, this);
+
+    std::vector<BatchPtr> early(batches.size(), nullptr);
+    uint64_t next = 0, primes = 0, written = 0;
+    double busy = 0, wait = 0;
+    try {
+        while (true) {
+            auto waitStart = PipelineClock::now();
+            BatchPtr batch = nullptr;
+            bool got = toOutput.pop(batch);
+            wait += secondsSince(waitStart);
+            if (!got) break;
+
+            auto busyStart = PipelineClock::now();
+            early[batch->sequence % early.size()] = batch;
+            while (BatchPtr ready = early[next % early.size()]) {
+                if (ready->sequence != next) break;
+                early[next % early.size()] = nullptr;
+                sink(ready->numbers, ready->text);
+                primes += ready->numbers.size();
+                next++;
+                written++;
+                freeBatches.push(ready);
+            }
+            busy += secondsSince(busyStart);
+        }
+    } catch (...) {
+        // The sink failed: stop generating and keep recycling batches so
+        // the other stages can drain, then rethrow
+        cancelled = true;
+        for (BatchPtr& batch : early) {
+            if (batch) freeBatches.push(batch);
+            batch = nullptr;
+        }
+        BatchPtr batch = nullptr;
+        while (toOutput.pop(batch)) freeBatches.push(batch);
+        generator.join();
+        engine.pool->wait();
+        for (std::thread& thread : encoderThreads) thread.join();
+        throw;
+    }
+
+    generator.join();
+    engine.pool->wait();
+    for (std::thread& thread : encoderThreads) thread.join();
+    addStats(3, written, busy, wait);
+    return primes;
+}
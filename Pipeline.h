@@ -0,0 +1,136 @@
+// Pipeline.h
+// Staged prime search: candidate generation, primality testing, text
+// encoding and output run at the same time, joined by bounded batch queues
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include "PrimeEngine.h"
+#include "CacheLine.h"
+
+// Fixed-capacity FIFO shared by the threads of two neighbouring stages.
+// push() blocks while the queue is full and pop() while it is empty; after
+// close() pop() drains what is left, then returns false. Each queue starts
+// on its own cache line, so the stages locking neighbouring queues do not
+// contend for one
+template <typename T>
+class alignas(PADDED_ALIGNMENT) BoundedQueue {
+private:
+    std::vector<T> ring;
+    size_t head = 0;
+    size_t size = 0;
+    bool closed = false;
+    std::mutex mtx;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : ring(capacity) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [this] { return size < ring.size(); });
+        ring[(head + size) % ring.size()] = std::move(item);
+        size++;
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [this] { return closed || size > 0; });
+        if (size == 0) return false;
+        item = std::move(ring[head]);
+        head = (head + 1) % ring.size();
+        size--;
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+// Time one stage's threads spent working and blocked on their queues
+struct PipelineStageStats {
+    const char* name;
+    int threads;
+    uint64_t batches = 0;
+    double busySeconds = 0;
+    double waitSeconds = 0;
+};
+
+// Runs a search as four stages over batches of BATCH_NUMBERS numbers:
+//   generate: one thread lists the mod-210 wheel candidates of a batch
+//   test:     the engine's pool workers keep the primes among them
+//   encode:   encoder threads format the primes as "Prime: p" lines
+//   output:   the calling thread puts batches back in order for the sink
+// Batches come from a fixed pool that the output stage recycles, so at most
+// POOL_PER_THREAD batches per thread are ever in flight: memory is bounded,
+// a slow stage holds the others back, and the steady state allocates
+// nothing. Primality testing uses the engine's backend, as the range scheme
+// does. The engine must not run another search while a pipeline runs
+class PrimePipeline {
+public:
+    static const uint64_t BATCH_NUMBERS = 1 << 16;
+    static const int POOL_PER_THREAD = 4;
+
+    // Called on the calling thread for every batch, in ascending order
+    typedef std::function<void(const std::vector<uint64_t>& primes, const std::string& text)> Sink;
+
+    // Throws std::invalid_argument for a bad window or encoder count
+    PrimePipeline(PrimeEngine& engine, uint64_t low, uint64_t high, int encoders);
+
+    PrimePipeline(const PrimePipeline&) = delete;
+    PrimePipeline& operator=(const PrimePipeline&) = delete;
+
+    // Runs every stage to the end; returns the number of primes
+    uint64_t run(const Sink& sink);
+
+    // generate, test, encode and output, after run()
+    const std::vector<PipelineStageStats>& stageStats() const { return stages; }
+
+private:
+    // Cache-line aligned: testers fill neighbouring batches at once
+    struct alignas(PADDED_ALIGNMENT) Batch {
+        uint64_t sequence = 0;
+        uint64_t low = 0;
+        uint64_t high = 0;
+        std::vector<uint64_t> numbers;   // Candidates, then the primes among them
+        std::string text;
+    };
+    typedef Batch* BatchPtr;
+
+    PrimeEngine& engine;
+    uint64_t low;
+    uint64_t high;
+    int encoders;
+    std::vector<std::unique_ptr<Batch>> batches;
+    BoundedQueue<BatchPtr> freeBatches;
+    BoundedQueue<BatchPtr> toTest;
+    BoundedQueue<BatchPtr> toEncode;
+    BoundedQueue<BatchPtr> toOutput;
+    std::mutex statsMutex;
+    std::vector<PipelineStageStats> stages;
+    int testersLeft = 0;              // Guarded by statsMutex; the last one closes toEncode
+    int encodersLeft = 0;
+    std::atomic<bool> cancelled{false}; // Set if the sink throws
+
+    static size_t poolSize(const PrimeEngine& engine, int encoders);
+    bool isPrime(uint64_t n, bool useTable) const;
+    void generate();
+    void test();
+    void encode();
+    void addStats(size_t stage, uint64_t batchCount, double busy, double wait);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef PRIMEBITMAP_H
+#define PRIMEBITMAP_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+
+// Compact result store: one bit per odd number in [low, high]
+// The only even prime, 2, is kept in a separate flag. Worker threads may
+// call set() concurrently; bits are OR-ed in atomically because two
+// threads' ranges can share a word at the boundary between them
+class PrimeBitmap {
+private:
+    uint64_t low;
+    uint64_t high;
+    uint64_t firstOdd;    // Number represented by bit 0
+    uint64_t numBits;
+    size_t numWords;
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    std::atomic<bool> hasTwo{false};
+
+    uint64_t bitIndex(uint64_t n) const { return (n - firstOdd) / 2; }
+    uint64_t numberAt(uint64_t bit) const { return firstOdd + 2 * bit; }
+    uint64_t word(size_t i) const { return words[i].load(std::memory_order_relaxed); }
+
+public:
+    PrimeBitmap(uint64_t lowNumber, uint64_t highNumber)
+        : low(lowNumber), high(highNumber) {
+        firstOdd = low | 1;
+        numBits = (low > high || firstOdd > high) ? 0 : (high - firstOdd) / 2 + 1;
+        numWords = static_cast<size_t>((numBits + 63) / 64);
+        words.reset(new std::atomic<uint64_t>[numWords]);
+        for (size_t i = 0; i < numWords; i++) {
+            words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    PrimeBitmap(const PrimeBitmap&) = delete;
+    PrimeBitmap& operator=(const PrimeBitmap&) = delete;
+
+    // Mark n as prime; n must lie in [low, high]
+    void set(uint64_t n) {
+        if (n == 2) {
+            hasTwo.store(true, std::memory_order_relaxed);
+            return;
+        }
+        uint64_t bit = bitIndex(n);
+        words[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+    }
+
+    bool test(uint64_t n) const {
+        if (n == 2) return hasTwo.load(std::memory_order_relaxed);
+        if (n % 2 == 0 || n < firstOdd || n > high) return false;
+        uint64_t bit = bitIndex(n);
+        return (word(bit / 64) >> (bit % 64)) & 1;
+    }
+
+    // Number of primes stored
+    uint64_t count() const {
+        uint64_t total = hasTwo.load(std::memory_order_relaxed) ? 1 : 0;
+        for (size_t i = 0; i < numWords; i++) {
+            total += __builtin_popcountll(word(i));
+        }
+        return total;
+    }
+
+    // The k-th stored prime, counting from 1; returns 0 if there are fewer than k
+    uint64_t nth(uint64_t k) const {
+        if (k == 0) return 0;
+        if (hasTwo.load(std::memory_order_relaxed)) {
+            if (k == 1) return 2;
+            k--;
+        }
+        for (size_t i = 0; i < numWords; i++) {
+            uint64_t bits = word(i);
+            uint64_t inWord = __builtin_popcountll(bits);
+            if (k > inWord) {
+                k -= inWord;
+                continue;
+            }
+            // Drop the lowest k - 1 set bits, the next one is the answer
+            while (--k > 0) bits &= bits - 1;
+            return numberAt(static_cast<uint64_t>(i) * 64 + __builtin_ctzll(bits));
+        }
+        return 0;
+    }
+
+    size_t memoryBytes() const { return numWords * sizeof(uint64_t); }
+
+    // Forward iterator over the stored primes in ascending order
+    class iterator {
+    private:
+        const PrimeBitmap* bitmap;
+        size_t wordIndex;
+        uint64_t bits;      // Bits of the current word not yet visited
+        bool atTwo;
+
+        void skipEmptyWords() {
+            while (bits == 0 && ++wordIndex < bitmap->numWords) {
+                bits = bitmap->word(wordIndex);
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef uint64_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const uint64_t* pointer;
+        typedef uint64_t reference;
+
+        iterator(const PrimeBitmap* owner, bool atEnd)
+            : bitmap(owner), wordIndex(0), bits(0), atTwo(false) {
+            if (atEnd) {
+                wordIndex = bitmap->numWords;
+                return;
+            }
+            atTwo = bitmap->hasTwo.load(std::memory_order_relaxed);
+            if (bitmap->numWords == 0) return;
+            bits = bitmap->word(0);
+            if (bits == 0) skipEmptyWords();
+        }
+
+        uint64_t operator*() const {
+            if (atTwo) return 2;
+            return bitmap->numberAt(static_cast<uint64_t>(wordIndex) * 64 + __builtin_ctzll(bits));
+        }
+
+        iterator& operator++() {
+            if (atTwo) {
+                atTwo = false;
+                return *this;
+            }
+            bits &= bits - 1;
+            skipEmptyWords();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return wordIndex == other.wordIndex && bits == other.bits && atTwo == other.atTwo;
+        }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+
+    iterator begin() const { return iterator(this, false); }
+    iterator end() const { return iterator(this, true); }
+
+    // Materialize the primes as a sorted vector, only when a caller needs one
+    std::vector<uint64_t> toVector() const {
+        std::vector<uint64_t> result;
+        result.reserve(static_cast<size_t>(count()));
+        for (uint64_t prime : *this) result.push_back(prime);
+        return result;
+    }
+};
+
+#endif
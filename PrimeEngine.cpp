@@ -0,0 +1,621 @@
+#include "PrimeEngine.h"
+#include "MillerRabin.h"
+#include "Wheel.h"
+#include "AllocationCounter.h"
+#include "SmallPrimes.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Constructor: the worker pool is started here and reused by every search
+PrimeEngine::PrimeEngine(const EngineOptions& opts) : origin(std::chrono::steady_clock::now()) {
+    setOptions(opts);
+}
+
+// Throws std::invalid_argument unless value is one of choices
+static void requireChoice(const char* name, const std::string& value,
+                          std::initializer_list<const char*> choices) {
+    for (const char* choice : choices) {
+        if (value == choice) return;
+    }
+    std::string allowed;
+    for (const char* choice : choices) allowed += (allowed.empty() ? "" : ", ") + std::string(choice);
+    throw std::invalid_argument("PrimeEngine: unknown " + std::string(name) + " \"" + value +
+                                "\" (expected " + allowed + ")");
+}
+
+// Change the options for later searches; the pool is only rebuilt if the
+// thread count or placement changes, and the base-prime table is always kept
+void PrimeEngine::setOptions(const EngineOptions& opts) {
+    if (opts.num_threads <= 0 || opts.chunk_size <= 0) {
+        throw std::invalid_argument("PrimeEngine: num_threads and chunk_size must be positive");
+    }
+    if (!Affinity::isPolicy(opts.affinity)) {
+        throw std::invalid_argument("PrimeEngine: affinity must be none, compact or spread");
+    }
+    requireChoice("division_scheme", opts.division_scheme, {"range", "divisibility", "sieve"});
+    requireChoice("scheduler", opts.scheduler, {"static", "dynamic"});
+    requireChoice("primality_test", opts.primality_test, {"trial", "miller_rabin"});
+    requireChoice("result_store", opts.result_store, {"vector", "bitmap", "aggregate"});
+    options = opts;
+    useMillerRabin = (options.primality_test == "miller_rabin");
+    kernel = DivisibilityKernel::select(options.divisibility_kernel);
+    if (!pool || pool->size() != options.num_threads || poolAffinity != options.affinity) {
+        pool.reset();  // Join the old workers before pinning new ones
+        pool.reset(new ThreadPool(options.num_threads,
+                                  Affinity::placement(options.affinity, options.num_threads)));
+        poolAffinity = options.affinity;
+        spawned += options.num_threads;
+    }
+}
+
+// Exact integer square root, floor(sqrt(n))
+// std::sqrt on a double can be off by one once n exceeds 2^52
+uint64_t PrimeEngine::isqrt(uint64_t n) {
+    uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+    while (r > 0 && r > n / r) r--;
+    while ((r + 1) <= n / (r + 1)) r++;
+    return r;
+}
+
+// Primality test used by the range scheme and candidate tests
+// Numbers below 2^16 are looked up in the compile-time table; above that it
+// dispatches to the backend picked by options.primality_test, and trial
+// division uses the base-prime table whenever it reaches sqrt(n)
+bool PrimeEngine::isPrime(uint64_t n) const {
+    if (n < SmallPrimes::LIMIT) return SmallPrimes::isPrime(n);
+    if (useMillerRabin) return MillerRabin::isPrime(n);
+    if (isqrt(n) <= basePrimeLimit) return isPrimeBasePrimes(n);
+    return isPrimeTrialDivision(n);
+}
+
+// Trial division by the base primes only, skipping every composite divisor
+// The table must cover every prime up to sqrt(n). The first skip primes are
+// left out, for callers that already know n is coprime to them. The
+// divisions tried are added to *divisions if it is given
+bool PrimeEngine::isPrimeBasePrimes(uint64_t n, size_t skip, uint64_t* divisions) const {
+    if (n < 2) return false;
+    uint32_t root = static_cast<uint32_t>(isqrt(n));
+    size_t count = std::upper_bound(basePrimes.begin(), basePrimes.end(), root) -
+                   basePrimes.begin();
+    if (count <= skip) return true;
+    size_t tried = count - skip;
+    size_t index = DivisibilityKernel::findDivisor(kernel, n, basePrimes.data() + skip, tried);
+    if (divisions) *divisions += (index < tried) ? index + 1 : tried;
+    return index == tried;
+}
+
+// Calls fn for the wheel primes of modulus M (those dividing it) that lie
+// in [start, end]; wheel candidates never include them
+template <uint32_t M, typename Fn>
+static void forEachWheelPrime(uint64_t start, uint64_t end, Fn fn) {
+    static const uint64_t wheelPrimes[] = {2, 3, 5, 7};
+    for (uint64_t p : wheelPrimes) {
+        if (M % p == 0 && p >= start && p <= end) fn(p);
+    }
+}
+
+// Basic primality test algorithm, for numbers beyond the base-prime table
+bool PrimeEngine::isPrimeTrialDivision(uint64_t n) {
+    if (n < 2) return false;
+    if (n == 2) return true;
+    if (n % 2 == 0) return false;
+    
+    uint64_t limit = isqrt(n);
+    for (uint64_t i = 3; i <= limit; i += 2) {
+        if (n % i == 0) return false;
+    }
+    return true;
+}
+
+// Lock-free method to add prime to the calling thread's own buffer
+// Each thread only ever touches threadPrimes[threadId - 1]
+// In bitmap mode the prime's bit is set in the shared bitmap instead, and
+// in aggregate mode it only updates the thread's totals. Every scheme
+// reports the primes of a chunk in ascending order
+// The caller's callback, if any, sees every prime as soon as it is found
+void PrimeEngine::addPrime(int threadId, uint64_t number) {
+    if (onPrime) onPrime(threadId, number);
+    if (useAggregate) {
+        AggregateState& state = threadAggregates[threadId - 1];
+        PrimeAggregate& totals = state.totals;
+        if (state.previous != 0 && number - state.previous == 2) totals.twinPairs++;
+        if (totals.count == 0 || number < totals.smallest) totals.smallest = number;
+        totals.largest = std::max(totals.largest, number);
+        totals.count++;
+        totals.sum += number;
+        state.previous = number;
+        return;
+    }
+    if (useBitmap) {
+        primeBitmap->set(number);
+        return;
+    }
+    threadPrimes[threadId - 1].push_back(number);
+}
+
+// Estimate how many primes lie in [start, end] using pi(n) ~ n / ln(n)
+// Padded by 25% since n / ln(n) undercounts, so buffers rarely regrow
+size_t PrimeEngine::estimatePrimeCount(uint64_t start, uint64_t end) {
+    auto pi = [](double n) { return n < 3 ? 1.0 : n / std::log(n); };
+    double estimate = pi(static_cast<double>(end)) - pi(static_cast<double>(start) - 1);
+    return static_cast<size_t>(std::max(0.0, estimate) * 1.25) + 16;
+}
+
+// DIVISION SCHEME 1: Range-based division
+// Each thread searches a contiguous range of numbers
+// Example: For 1-1000 with 4 threads: [1-250], [251-500], [501-750], [751-1000]
+// Only numbers coprime to 210 are tested, so trial division can skip the
+// wheel primes as divisors too
+void PrimeEngine::searchRange(int threadId, uint64_t start, uint64_t end, ThreadStats& stats) {
+    uint64_t tested = 0, divisions = 0, found = 0;
+    forEachWheelPrime<210>(start, end, [&](uint64_t p) { addPrime(threadId, p); found++; });
+    
+    bool useTable = !useMillerRabin && isqrt(end) <= basePrimeLimit;
+    for (uint64_t num : Wheel<210>::candidates(start, end)) {
+        tested++;
+        bool prime = (useTable && num >= SmallPrimes::LIMIT)
+                         ? isPrimeBasePrimes(num, WHEEL_PRIMES, &divisions) : isPrime(num);
+        if (prime) {
+            addPrime(threadId, num);
+            found++;
+        }
+    }
+    
+    stats.numbersTested += tested;
+    stats.divisions += divisions;
+    stats.primesFound += found;
+}
+
+// Each thread checks a subset of divisors for a single number
+// Polls the shared flag every CANCEL_POLL_INTERVAL divisors and gives up
+// early once another thread has already found a factor
+// The divisors are a view into the shared base-prime table, never a copy
+// Returns the number of divisions performed
+uint64_t PrimeEngine::checkDivisibility(uint64_t number, const uint32_t* divisors, size_t count,
+                                        DivisibilityResult* result) {
+    for (size_t i = 0; i < count; i += CANCEL_POLL_INTERVAL) {
+        if (result->isComposite.load(std::memory_order_relaxed)) {
+            return i;  // A sibling already proved the number composite
+        }
+        size_t block = std::min<size_t>(CANCEL_POLL_INTERVAL, count - i);
+        size_t index = DivisibilityKernel::findDivisor(kernel, number, divisors + i, block);
+        if (index < block) {
+            result->isComposite.store(true, std::memory_order_relaxed);
+            return i + index + 1;  // Found a divisor, number is composite
+        }
+    }
+    return count;
+}
+
+// Pool task of isPrimeParallel: checks one slice and adds up its counters
+void PrimeEngine::runSlice(DivisibilitySlice& slice) {
+    uint64_t allocationsBefore = AllocationCounter::thisThread();
+    auto begin = std::chrono::steady_clock::now();
+    slice.divisions += checkDivisibility(slice.number, slice.divisors, slice.count, slice.result);
+    std::chrono::duration<double> busy = std::chrono::steady_clock::now() - begin;
+    slice.busySeconds += busy.count();
+    slice.allocations += AllocationCounter::thisThread() - allocationsBefore;
+}
+
+// DIVISION SCHEME 2: Parallel primality test
+// Uses the worker pool to test divisibility of a single number
+// The number must be a wheel candidate (coprime to 210), so only the base
+// primes from 11 up to sqrt(number) are tried, and each worker gets a
+// slice of the shared table rather than its own copy. Nothing is
+// allocated per number: the slices are reused and the barrier is the pool's.
+// Numbers below 2^16 are looked up in the compile-time table instead
+bool PrimeEngine::isPrimeParallel(uint64_t number, ThreadStats& stats) {
+    if (number < 2) return false;
+    if (number < SmallPrimes::LIMIT) return SmallPrimes::isPrime(number);
+    
+    uint32_t sqrtN = static_cast<uint32_t>(isqrt(number));
+    
+    size_t skip = std::min<size_t>(WHEEL_PRIMES, basePrimes.size());
+    const uint32_t* divisors = basePrimes.data() + skip;
+    size_t numDivisors = std::upper_bound(basePrimes.begin() + skip, basePrimes.end(), sqrtN) -
+                         (basePrimes.begin() + skip);
+    
+    if (numDivisors == 0) return true;
+    
+    // Divide divisors among the pool workers
+    DivisibilityResult result;
+    int numChunks = pool->size();
+    size_t chunkSize = std::max<size_t>(1, numDivisors / numChunks);
+    
+    for (int i = 0; i < numChunks; i++) {
+        size_t startIdx = static_cast<size_t>(i) * chunkSize;
+        size_t endIdx = (i == numChunks - 1) ? numDivisors : startIdx + chunkSize;
+        
+        if (startIdx >= numDivisors) break;
+        
+        DivisibilitySlice* slice = &slices[i];
+        slice->number = number;
+        slice->divisors = divisors + startIdx;
+        slice->count = endIdx - startIdx;
+        slice->result = &result;
+        pool->submit([this, slice] { runSlice(*slice); });
+    }
+    
+    // Completion barrier: wait for all divisibility checks
+    auto begin = std::chrono::steady_clock::now();
+    pool->wait();
+    std::chrono::duration<double> waited = std::chrono::steady_clock::now() - begin;
+    stats.waitSeconds += waited.count();
+    
+    return !result.isComposite.load();
+}
+
+// Search using parallel divisibility testing, over wheel candidates only
+void PrimeEngine::searchWithDivisibilityThreads(int threadId, uint64_t start, uint64_t end,
+                                                ThreadStats& stats) {
+    forEachWheelPrime<210>(start, end, [&](uint64_t p) {
+        addPrime(threadId, p);
+        stats.primesFound++;
+    });
+    
+    for (uint64_t num : Wheel<210>::candidates(start, end)) {
+        stats.numbersTested++;
+        if (isPrimeParallel(num, stats)) {
+            addPrime(threadId, num);
+            stats.primesFound++;
+        }
+    }
+}
+
+// Cross off multiples of sievingPrimes in [base, high], base a multiple of 30
+// The segment uses the mod-30 wheel layout: byte 8 * t + s stands for
+// base + 30 * t + the s-th residue coprime to 30 (1, 7, 11, ..., 29), so
+// multiples of 2, 3 and 5 take no space and are never crossed off.
+// Afterwards a byte is 1 exactly when its number has no factor in the list
+// below itself; the list must cover every prime up to sqrt(high)
+// Returns the number of bytes crossed off
+uint64_t PrimeEngine::sieveSegment(uint64_t base, uint64_t high,
+                                   const std::vector<uint32_t>& sievingPrimes,
+                                   std::vector<uint8_t>& segment) {
+    std::fill(segment.begin(), segment.begin() + ((high - base) / 30 + 1) * 8, 1);
+    uint64_t crossings = 0;
+    
+    for (uint32_t p : sievingPrimes) {
+        if (p < 7) continue;  // Already left out by the layout
+        uint64_t square = static_cast<uint64_t>(p) * p;
+        if (square > high) break;
+        
+        // Only multiples p * k with k coprime to 30 have a byte, so step k
+        // around the wheel from the first multiple inside the segment
+        // (never p itself)
+        uint64_t k = std::max<uint64_t>(p, (base + p - 1) / p);
+        for (auto it = Wheel<30>::firstCandidate(k); ; ++it) {
+            uint64_t offset = p * *it - base;
+            if (offset > high - base) break;
+            segment[offset / 30 * 8 + wheelTables<30>.spoke[offset % 30]] = 0;
+            crossings++;
+        }
+    }
+    return crossings;
+}
+
+// Calls fn for every number in [low, high] above 1 whose byte is still set
+// after sieveSegment(base, high, ...)
+template <typename Fn>
+static void forEachUnmarked(uint64_t base, uint64_t low, uint64_t high,
+                            const std::vector<uint8_t>& segment, Fn fn) {
+    size_t bytes = ((high - base) / 30 + 1) * 8;
+    for (size_t i = 0; i < bytes; i++) {
+        if (!segment[i]) continue;
+        uint64_t num = base + i / 8 * 30 + wheelTables<30>.residue[i % 8];
+        if (num >= low && num <= high && num > 1) fn(num);
+    }
+}
+
+// Base primes up to sqrt(max_number), shared read-only by every search
+// thread: the sieve crosses off their multiples and trial division only
+// divides by them. Kept between searches and only recomputed when a later search
+// needs a higher limit. The primes below 2^16 are copied from the
+// compile-time table, so searches up to 2^32 build it without sieving;
+// beyond that it is sieved in segments, so even the 2^31 limit of a 2^62
+// search only ever holds one segment plus the primes
+void PrimeEngine::computeBasePrimes(uint32_t limit) {
+    if (limit <= basePrimeLimit) return;
+    basePrimeLimit = limit;
+    
+    basePrimes.reserve(estimatePrimeCount(2, limit));
+    basePrimes.assign(SmallPrimes::begin(),
+                      std::upper_bound(SmallPrimes::begin(), SmallPrimes::end(), limit));
+    if (limit < SmallPrimes::LIMIT) return;
+    
+    // The table also holds every sieving prime, up to sqrt(limit) < 2^16
+    uint32_t root = static_cast<uint32_t>(isqrt(limit));
+    const uint32_t* rootEnd = std::upper_bound(SmallPrimes::begin(), SmallPrimes::end(), root);
+    std::vector<uint32_t> sievingPrimes(SmallPrimes::begin(), rootEnd);
+    auto push = [this](uint64_t p) { basePrimes.push_back(static_cast<uint32_t>(p)); };
+    std::vector<uint8_t> segment(SIEVE_SEGMENT_BYTES);
+    for (uint64_t base = SmallPrimes::LIMIT / 30 * 30; base <= limit; base += SIEVE_SEGMENT_SIZE) {
+        uint64_t high = std::min<uint64_t>(base + SIEVE_SEGMENT_SIZE - 1, limit);
+        sieveSegment(base, high, sievingPrimes, segment);
+        forEachUnmarked(base, SmallPrimes::LIMIT, high, segment, push);
+    }
+}
+
+// Sieve [start, end] in cache-sized segments with the shared base primes,
+// calling fn for each prime in ascending order. segment is the caller's
+// scratch space of SIEVE_SEGMENT_BYTES. Returns the bytes crossed off
+template <typename Fn>
+uint64_t PrimeEngine::sieveRange(uint64_t start, uint64_t end, std::vector<uint8_t>& segment,
+                                 Fn fn) const {
+    // The part of the window below 2^16 is read from the compile-time table
+    if (start < SmallPrimes::LIMIT) {
+        const uint32_t* p = std::lower_bound(SmallPrimes::begin(), SmallPrimes::end(), start);
+        for (; p != SmallPrimes::end() && *p <= end; ++p) fn(*p);
+        if (end < SmallPrimes::LIMIT) return 0;
+        start = SmallPrimes::LIMIT;
+    }
+    
+    uint64_t crossings = 0;
+    for (uint64_t base = start / 30 * 30; base <= end; base += SIEVE_SEGMENT_SIZE) {
+        uint64_t high = std::min<uint64_t>(base + SIEVE_SEGMENT_SIZE - 1, end);
+        crossings += sieveSegment(base, high, basePrimes, segment);
+        forEachUnmarked(base, start, high, segment, fn);
+    }
+    return crossings;
+}
+
+// DIVISION SCHEME 3: Segmented sieve of Eratosthenes
+// Each thread sieves its own range in cache-sized segments, crossing off
+// multiples of the shared base primes instead of trial dividing every number
+// The segment is per worker thread and reused by every chunk it sieves
+void PrimeEngine::searchSieve(int threadId, uint64_t start, uint64_t end, ThreadStats& stats) {
+    thread_local std::vector<uint8_t> segment;
+    segment.resize(SIEVE_SEGMENT_BYTES);
+    uint64_t found = 0;
+    stats.crossings += sieveRange(start, end, segment,
+                                  [&](uint64_t p) { addPrime(threadId, p); found++; });
+    stats.numbersTested += end - start + 1;
+    stats.primesFound += found;
+}
+
+// Appends the primes of [start, end] to primes, in ascending order, for
+// callers that drive their own threads. The base primes must already reach
+// sqrt(end); safe to call from several threads at once
+void PrimeEngine::sieveWindow(uint64_t start, uint64_t end, std::vector<uint8_t>& segment,
+                              std::vector<uint64_t>& primes) const {
+    segment.resize(SIEVE_SEGMENT_BYTES);
+    sieveRange(start, end, segment, [&primes](uint64_t p) { primes.push_back(p); });
+}
+
+// Runs one chunk or block of a worker, timing it into the thread's stats
+// and recording a trace event if tracing is on
+void PrimeEngine::runTimed(int threadId, SearchFn search, uint64_t start, uint64_t end) {
+    ThreadStats& stats = threadStats[threadId - 1];
+    uint64_t primesBefore = stats.primesFound;
+    uint64_t allocationsBefore = AllocationCounter::thisThread();
+    auto begin = std::chrono::steady_clock::now();
+    if (useAggregate) threadAggregates[threadId - 1].previous = 0;
+    (this->*search)(threadId, start, end, stats);
+    if (useAggregate) {
+        // A twin pair belongs to the chunk of its smaller prime, so one
+        // ending at end - 1 or end needs its partner past the chunk checked
+        AggregateState& state = threadAggregates[threadId - 1];
+        if (state.previous != 0 && state.previous + 1 >= end && state.previous + 2 <= searchHigh &&
+            isPrime(state.previous + 2)) {
+            state.totals.twinPairs++;
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    stats.allocations += AllocationCounter::thisThread() - allocationsBefore;
+    
+    std::chrono::duration<double> busy = finish - begin;
+    stats.busySeconds += busy.count();
+    stats.chunks++;
+    if (options.trace) {
+        std::chrono::duration<double, std::micro> at = begin - origin;
+        threadTrace[threadId - 1].push_back({at.count(), busy.count() * 1e6, start, end,
+                                             stats.primesFound - primesBefore});
+    }
+}
+
+// STATIC SCHEDULER: The thread searches one fixed block [start, end]
+void PrimeEngine::staticWorker(int threadId, SearchFn search, uint64_t start, uint64_t end) {
+    if (!useBitmap && !useAggregate) threadPrimes[threadId - 1].reserve(estimatePrimeCount(start, end));
+    runTimed(threadId, search, start, end);
+}
+
+// DYNAMIC SCHEDULER: The thread keeps claiming the next unsearched chunk
+// from a shared atomic counter, so threads that draw cheap chunks (small
+// numbers) simply take more of them and all threads finish together
+void PrimeEngine::dynamicWorker(int threadId, SearchFn search) {
+    std::vector<uint64_t>& buffer = threadPrimes[threadId - 1];
+    if (!useBitmap && !useAggregate) {
+        buffer.reserve(estimatePrimeCount(searchLow, searchHigh) / options.num_threads);
+    }
+    uint64_t numChunks = (searchHigh - searchLow) / options.chunk_size + 1;
+    
+    while (true) {
+        uint64_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= numChunks) break;
+        uint64_t start = searchLow + chunk * options.chunk_size;
+        uint64_t end = std::min<uint64_t>(start + options.chunk_size - 1, searchHigh);
+        
+        size_t first = buffer.size();
+        runTimed(threadId, search, start, end);
+        if (!useBitmap && !useAggregate) {
+            threadChunks[threadId - 1].push_back({chunk, first, buffer.size()});
+        }
+    }
+}
+
+// Merge the per-thread buffers once into the sorted primes vector
+void PrimeEngine::mergeResults() {
+    size_t totalPrimes = 0;
+    for (const auto& buffer : threadPrimes) {
+        totalPrimes += buffer.size();
+    }
+    primes.reserve(totalPrimes);
+    
+    if (options.scheduler == "dynamic" && options.division_scheme != "divisibility") {
+        // Chunks ascend with their index and each thread claimed its chunks
+        // in increasing order, so repeatedly take the thread whose next
+        // chunk is lowest and copy that slice out of its buffer
+        std::vector<size_t> cursor(threadChunks.size(), 0);
+        while (true) {
+            int next = -1;
+            for (size_t t = 0; t < threadChunks.size(); t++) {
+                if (cursor[t] == threadChunks[t].size()) continue;
+                if (next < 0 || threadChunks[t][cursor[t]].chunk <
+                                threadChunks[next][cursor[next]].chunk) {
+                    next = static_cast<int>(t);
+                }
+            }
+            if (next < 0) break;
+            
+            const ChunkSpan& span = threadChunks[next][cursor[next]++];
+            const std::vector<uint64_t>& buffer = threadPrimes[next];
+            primes.insert(primes.end(), buffer.begin() + span.begin,
+                          buffer.begin() + span.end);
+        }
+    } else {
+        // Threads own ascending blocks (and the divisibility scheme searches
+        // linearly), so concatenating them in thread order is already sorted
+        for (const auto& buffer : threadPrimes) {
+            primes.insert(primes.end(), buffer.begin(), buffer.end());
+        }
+    }
+    
+    threadPrimes.clear();
+    threadChunks.clear();
+}
+
+// Find every prime in [low, high]. onPrime, if set, is called from the
+// worker threads for each prime as it is found (in no particular order);
+// afterwards the sorted results are available through primeList(),
+// bitmap(), forEachPrime() or getPrimes() until the next search
+SearchResult PrimeEngine::search(uint64_t low, uint64_t high, PrimeCallback callback) {
+    if (low > high || high > MAX_NUMBER) {
+        throw std::invalid_argument("PrimeEngine: low must not exceed high, high must not exceed 2^63");
+    }
+    auto startTime = std::chrono::high_resolution_clock::now();
+    
+    searchLow = low;
+    searchHigh = high;
+    onPrime = std::move(callback);
+    primes.clear();
+    useBitmap = (options.result_store == "bitmap");
+    useAggregate = (options.result_store == "aggregate");
+    primeBitmap.reset(useBitmap ? new PrimeBitmap(low, high) : nullptr);
+    threadAggregates.assign(useAggregate ? options.num_threads : 0, AggregateState());
+    aggregateTotals = PrimeAggregate();
+    threadPrimes.assign(options.num_threads, CacheAligned<std::vector<uint64_t>>());
+    threadChunks.assign(options.num_threads, CacheAligned<std::vector<ChunkSpan>>());
+    threadStats.assign(options.num_threads, ThreadStats());
+    threadTrace.assign(options.trace ? options.num_threads : 0,
+                       CacheAligned<std::vector<TraceEvent>>());
+    slices.assign(pool->size(), DivisibilitySlice());
+    
+    // Trial division in every scheme only tries primes, so build the shared
+    // table of primes up to sqrt(high) up front (Miller-Rabin needs none)
+    if (options.division_scheme == "sieve" || options.division_scheme == "divisibility" ||
+        !useMillerRabin) {
+        computeBasePrimes(static_cast<uint32_t>(isqrt(high)));
+    }
+    
+    // FEATURE: Division scheme selection
+    // setOptions only admits the three schemes, so every one is named here
+    if (options.division_scheme == "divisibility") {
+        // Divisibility division: Linear search, each number is tested in
+        // parallel by the pool, so only num_threads workers ever run at once
+        staticWorker(1, &PrimeEngine::searchWithDivisibilityThreads, low, high);
+    }
+    else {
+        SearchFn searchFn = nullptr;
+        if (options.division_scheme == "range") {
+            // Range division: each thread tests the wheel candidates of its range
+            searchFn = &PrimeEngine::searchRange;
+        } else if (options.division_scheme == "sieve") {
+            // Segmented sieve: base primes are shared, each thread sieves its own range
+            searchFn = &PrimeEngine::searchSieve;
+        } else {
+            throw std::logic_error("PrimeEngine: no search for scheme " + options.division_scheme);
+        }
+        
+        if (options.scheduler == "dynamic") {
+            // Dynamic scheduling: workers pull chunk_size chunks until none are left
+            nextChunk = 0;
+            for (int i = 0; i < options.num_threads; i++) {
+                pool->submit([this, i, searchFn] { dynamicWorker(i + 1, searchFn); });
+            }
+        }
+        else if (options.scheduler == "static") {
+            // Range division: Split the number range among the workers
+            // (never more workers than numbers, so no block is empty)
+            uint64_t span = high - low + 1;
+            int workers = static_cast<int>(std::min<uint64_t>(options.num_threads, span));
+            uint64_t rangeSize = span / workers;
+            
+            for (int i = 0; i < workers; i++) {
+                uint64_t start = low + i * rangeSize;
+                uint64_t end = (i == workers - 1) ? high : start + rangeSize - 1;
+                
+                pool->submit([this, i, searchFn, start, end] {
+                    staticWorker(i + 1, searchFn, start, end);
+                });
+            }
+        }
+        else {
+            throw std::logic_error("PrimeEngine: no scheduler " + options.scheduler);
+        }
+        
+        // Wait for all workers to complete
+        pool->wait();
+    }
+    
+    onPrime = PrimeCallback();
+    if (useAggregate) {
+        for (const AggregateState& state : threadAggregates) {
+            const PrimeAggregate& part = state.totals;
+            if (part.count == 0) continue;
+            if (aggregateTotals.count == 0 || part.smallest < aggregateTotals.smallest) {
+                aggregateTotals.smallest = part.smallest;
+            }
+            aggregateTotals.largest = std::max(aggregateTotals.largest, part.largest);
+            aggregateTotals.count += part.count;
+            aggregateTotals.sum += part.sum;
+            aggregateTotals.twinPairs += part.twinPairs;
+        }
+        threadPrimes.clear();
+        threadChunks.clear();
+    } else if (!useBitmap) {
+        mergeResults();
+    }
+    
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    
+    // Divisor slices ran on the pool for thread 1; credit slice i to row i.
+    // Thread 1's own busy time already spans its slices
+    for (size_t i = 0; i < slices.size() && i < threadStats.size(); i++) {
+        threadStats[i].divisions += slices[i].divisions;
+        threadStats[i].allocations += slices[i].allocations;
+        if (i > 0) threadStats[i].busySeconds += slices[i].busySeconds;
+    }
+    for (ThreadStats& stats : threadStats) {
+        stats.idleSeconds = std::max(0.0, elapsed.count() - stats.busySeconds);
+    }
+    
+    SearchResult result;
+    result.primeCount = count();
+    result.seconds = elapsed.count();
+    return result;
+}
+
+// Number of primes found by the last search
+uint64_t PrimeEngine::count() const {
+    if (useAggregate) return aggregateTotals.count;
+    if (useBitmap) return primeBitmap ? primeBitmap->count() : 0;
+    return primes.size();
+}
+
+// Found primes in ascending order; the bitmap is only expanded on request
+std::vector<uint64_t> PrimeEngine::getPrimes() const {
+    if (useBitmap) return primeBitmap ? primeBitmap->toVector() : std::vector<uint64_t>();
+    return primes;
+}
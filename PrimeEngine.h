@@ -0,0 +1,273 @@
+// PrimeEngine.h
+// Embeddable prime search engine, free of any console or config file I/O
+#ifndef PRIMEENGINE_H
+#define PRIMEENGINE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <chrono>
+#include "ThreadPool.h"
+#include "PrimeBitmap.h"
+#include "DivisibilityKernel.h"
+#include "CacheLine.h"
+
+// How the engine searches; the computational subset of Config
+struct EngineOptions {
+    int num_threads = 1;
+    std::string division_scheme = "range";  // "range", "divisibility" or "sieve"
+    std::string scheduler = "static";       // "static" or "dynamic"
+    int chunk_size = 8192;                  // Numbers per dynamic chunk
+    std::string primality_test = "trial";   // "trial" or "miller_rabin"
+    std::string result_store = "vector";    // "vector", "bitmap" or "aggregate" (totals only)
+    std::string divisibility_kernel = "auto"; // "auto", "scalar", "avx2", "avx512" or "neon"
+    bool trace = false;                     // Record a TraceEvent per chunk or block
+    std::string affinity = "none";          // Worker placement: "none", "compact" or "spread"
+};
+
+// Sum of primes, 128 bits wide. GCC and Clang have a native type; other
+// compilers get two 64-bit halves added with carry, which is all the
+// aggregate store does with it
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 PrimeSum;
+inline uint64_t sumHigh(PrimeSum sum) { return static_cast<uint64_t>(sum >> 64); }
+inline uint64_t sumLow(PrimeSum sum) { return static_cast<uint64_t>(sum); }
+#else
+struct PrimeSum {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    PrimeSum(uint64_t value = 0) : low(value) {}
+    PrimeSum& operator+=(const PrimeSum& other) {
+        low += other.low;
+        high += other.high + (low < other.low ? 1 : 0);
+        return *this;
+    }
+};
+inline uint64_t sumHigh(const PrimeSum& sum) { return sum.high; }
+inline uint64_t sumLow(const PrimeSum& sum) { return sum.low; }
+#endif
+
+// Totals of the primes of a search, kept by the "aggregate" result store
+// instead of the primes themselves. A twin pair (p, p + 2) is counted when
+// both lie in the window
+struct PrimeAggregate {
+    uint64_t count = 0;
+    PrimeSum sum = 0;            // Overflows 64 bits from about 2^34 on
+    uint64_t twinPairs = 0;
+    uint64_t smallest = 0;       // 0 if no prime was found
+    uint64_t largest = 0;
+};
+
+// Outcome of one search
+struct SearchResult {
+    uint64_t primeCount = 0;
+    double seconds = 0;          // Wall time of the search itself
+};
+
+// Per-thread statistics of the last search. Counters are kept in locals on
+// the hot path and added once per chunk, so collecting them costs nothing
+// measurable. In the divisibility scheme thread 1 runs the candidate loop
+// and row i also counts the divisions and allocations of divisor slice i.
+// Each row fills whole cache lines, so neighbouring workers' updates never
+// contend for one
+struct alignas(PADDED_ALIGNMENT) ThreadStats {
+    double busySeconds = 0;   // Time spent searching (excludes waiting for work)
+    double idleSeconds = 0;   // Rest of the search's wall time
+    double waitSeconds = 0;   // Blocked on the pool's completion barrier
+    int chunks = 0;           // Chunks or blocks processed
+    uint64_t numbersTested = 0; // Wheel candidates tested, or numbers sieved
+    uint64_t divisions = 0;   // Trial divisions performed
+    uint64_t crossings = 0;   // Multiples crossed off by the sieve
+    uint64_t primesFound = 0;
+    uint64_t allocations = 0; // Heap allocations while searching (see AllocationCounter.h)
+};
+
+// One chunk or block a thread searched, for trace export (options.trace)
+struct TraceEvent {
+    double startMicros;       // Since the engine was created
+    double durationMicros;
+    uint64_t low;             // Numbers searched
+    uint64_t high;
+    uint64_t primes;          // Primes found in them
+};
+
+// Called from worker threads for every prime as it is found
+typedef std::function<void(int threadId, uint64_t prime)> PrimeCallback;
+
+// Reusable search engine. The worker pool and the sieve's base-prime table
+// live as long as the engine, so repeated searches skip that setup cost.
+// Invalid arguments throw std::invalid_argument. One search at a time
+class PrimeEngine {
+private:
+    // Numbers per sieve segment, a multiple of 30; the mod-30 wheel layout
+    // stores 8 bytes per 30 numbers, so a segment is 32 KB and stays in L1/L2
+    static const int SIEVE_SEGMENT_SIZE = 32768 / 8 * 30;
+    static const int SIEVE_SEGMENT_BYTES = SIEVE_SEGMENT_SIZE / 30 * 8;
+    // Primes 2, 3, 5 and 7, which the mod-210 wheel skips as divisors
+    static const size_t WHEEL_PRIMES = 4;
+    // Divisor checks between polls of the shared cancellation flag
+    static const int CANCEL_POLL_INTERVAL = 64;
+
+    // A search implementation that covers [start, end] for one thread and
+    // adds its counters to stats
+    typedef void (PrimeEngine::*SearchFn)(int threadId, uint64_t start, uint64_t end,
+                                          ThreadStats& stats);
+
+    // Slice of a thread's result buffer holding the primes of one chunk
+    struct ChunkSpan {
+        uint64_t chunk;
+        size_t begin;
+        size_t end;
+    };
+
+    // Helper structure for divisibility testing
+    // Doubles as a cancellation token: once any worker sets isComposite,
+    // its siblings see it on their next poll and stop scanning. It lives on
+    // the candidate loop's stack, so it gets a line of its own: polling it
+    // must not pull in the loop's locals
+    struct alignas(PADDED_ALIGNMENT) DivisibilityResult {
+        std::atomic<bool> isComposite{false};  // True if number is definitely not prime
+    };
+
+    // A worker's aggregate totals, plus the last prime of the chunk it is on
+    // so twin pairs inside the chunk are seen as the primes arrive. Updated
+    // for every prime, so each worker's state has its own cache lines
+    struct alignas(PADDED_ALIGNMENT) AggregateState {
+        PrimeAggregate totals;
+        uint64_t previous = 0;        // 0 at the start of every chunk
+    };
+
+    // One worker's share of the number isPrimeParallel is testing. The
+    // slices are allocated once per search and rewritten for every number,
+    // and a task captures only a pointer to its slice, which fits inside
+    // std::function, so testing a candidate never touches the heap. Slices
+    // are cache-line aligned as every worker writes its own for each number
+    struct alignas(PADDED_ALIGNMENT) DivisibilitySlice {
+        uint64_t number = 0;
+        const uint32_t* divisors = nullptr;
+        size_t count = 0;
+        DivisibilityResult* result = nullptr;
+        uint64_t divisions = 0;       // Totals over the search
+        double busySeconds = 0;
+        uint64_t allocations = 0;
+    };
+
+    EngineOptions options;
+    uint64_t searchLow = 0;           // Window of the current search
+    uint64_t searchHigh = 0;
+    PrimeCallback onPrime;            // Caller's per-prime callback, may be empty
+    std::vector<uint64_t> primes;     // Stores all found prime numbers
+    // Per-thread buffers, padded so pushes by neighbouring workers do not
+    // write to one cache line through the vector headers
+    std::vector<CacheAligned<std::vector<uint64_t>>> threadPrimes; // Result buffers, merged after the search
+    std::vector<CacheAligned<std::vector<ChunkSpan>>> threadChunks; // Chunks each dynamic worker claimed
+    std::vector<ThreadStats> threadStats;
+    std::vector<AggregateState> threadAggregates; // Per-thread totals in aggregate mode
+    PrimeAggregate aggregateTotals;   // Their sum after the search
+    std::vector<DivisibilitySlice> slices; // Divisibility scheme: one per pool worker
+    std::vector<CacheAligned<std::vector<TraceEvent>>> threadTrace; // Per-thread events when options.trace is set
+    std::chrono::steady_clock::time_point origin; // Time base of TraceEvent
+    int spawned = 0;                  // Pool threads started over the engine's life
+    // Next chunk index for the dynamic scheduler. Every worker bumps it, so
+    // it is kept off the line of the read-mostly members around it
+    CacheAligned<std::atomic<uint64_t>> nextChunk{0};
+    std::vector<uint32_t> basePrimes; // Primes up to sqrt(high), shared by the sieve and trial division
+    uint32_t basePrimeLimit = 0;      // basePrimes covers every prime up to this
+    std::unique_ptr<ThreadPool> pool; // Long-lived workers shared by every scheme
+    std::string poolAffinity;         // Placement the pool was started with
+    bool useMillerRabin = false;      // Cached from options.primality_test for the hot path
+    DivisibilityKernel::Kind kernel = DivisibilityKernel::SCALAR; // Resolved options.divisibility_kernel
+    std::unique_ptr<PrimeBitmap> primeBitmap; // Result store when result_store is "bitmap"
+    bool useBitmap = false;           // Cached from options.result_store for the hot path
+    bool useAggregate = false;
+
+    // Prime checking algorithms
+    static bool isPrimeTrialDivision(uint64_t n);
+    bool isPrimeBasePrimes(uint64_t n, size_t skip = 0, uint64_t* divisions = nullptr) const;
+    bool isPrimeParallel(uint64_t number, ThreadStats& stats);
+
+    // Thread-safe operations
+    void addPrime(int threadId, uint64_t number);
+
+    // Division scheme implementations
+    void searchRange(int threadId, uint64_t start, uint64_t end, ThreadStats& stats);
+    void searchWithDivisibilityThreads(int threadId, uint64_t start, uint64_t end,
+                                       ThreadStats& stats);
+    uint64_t checkDivisibility(uint64_t number, const uint32_t* divisors, size_t count,
+                               DivisibilityResult* result);
+    void runSlice(DivisibilitySlice& slice);
+    void computeBasePrimes(uint32_t limit);
+    static uint64_t sieveSegment(uint64_t base, uint64_t high,
+                                 const std::vector<uint32_t>& sievingPrimes,
+                                 std::vector<uint8_t>& segment);
+    template <typename Fn>
+    uint64_t sieveRange(uint64_t start, uint64_t end, std::vector<uint8_t>& segment, Fn fn) const;
+    void searchSieve(int threadId, uint64_t start, uint64_t end, ThreadStats& stats);
+    void runTimed(int threadId, SearchFn search, uint64_t start, uint64_t end);
+
+    // Scheduling: hand each thread a fixed block or let it pull chunks
+    void staticWorker(int threadId, SearchFn search, uint64_t start, uint64_t end);
+    void dynamicWorker(int threadId, SearchFn search);
+    void mergeResults();
+
+    // Streams run the sieve, and pipelines their testing stage, on this
+    // engine's pool
+    friend class PrimeStream;
+    friend class PrimePipeline;
+
+public:
+    // Largest high a search accepts. The sieve and the wheel step past the
+    // end of their range, so the top of uint64_t is left as headroom
+    static const uint64_t MAX_NUMBER = 1ULL << 63;
+
+    explicit PrimeEngine(const EngineOptions& opts = EngineOptions());
+
+    PrimeEngine(const PrimeEngine&) = delete;
+    PrimeEngine& operator=(const PrimeEngine&) = delete;
+
+    void setOptions(const EngineOptions& opts);
+    const EngineOptions& getOptions() const { return options; }
+    // Trial division kernel actually in use, after CPU dispatch
+    const char* kernelName() const { return DivisibilityKernel::name(kernel); }
+
+    SearchResult search(uint64_t low, uint64_t high, PrimeCallback callback = PrimeCallback());
+
+    // end must not exceed MAX_NUMBER
+    void sieveWindow(uint64_t start, uint64_t end, std::vector<uint8_t>& segment,
+                     std::vector<uint64_t>& primes) const;
+
+    // Single-number test with the configured primality backend
+    bool isPrime(uint64_t n) const;
+
+    // Results of the last search, in ascending order
+    // In aggregate mode no prime is kept: only count() and aggregate() apply
+    uint64_t count() const;
+    const PrimeAggregate& aggregate() const { return aggregateTotals; }
+    const std::vector<uint64_t>& primeList() const { return primes; }   // Empty in bitmap mode
+    const PrimeBitmap* bitmap() const { return primeBitmap.get(); }     // Null in vector mode
+    std::vector<uint64_t> getPrimes() const;
+
+    template <typename Fn>
+    void forEachPrime(Fn fn) const {
+        if (useBitmap && primeBitmap) {
+            for (uint64_t prime : *primeBitmap) fn(prime);
+        } else {
+            for (uint64_t prime : primes) fn(prime);
+        }
+    }
+
+    const std::vector<ThreadStats>& getThreadStats() const { return threadStats; }
+    // Chunks each thread searched in the last search, if options.trace was set
+    const std::vector<CacheAligned<std::vector<TraceEvent>>>& getTrace() const { return threadTrace; }
+    // Worker threads the engine has started, counting pool rebuilds
+    int threadsSpawned() const { return spawned; }
+
+    static uint64_t isqrt(uint64_t n);
+    static size_t estimatePrimeCount(uint64_t start, uint64_t end);
+};
+
+#endif
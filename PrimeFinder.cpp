@@ -1,5 +1,12 @@
 #include "PrimeFinder.h"
 #include "SimpleJSON.h"
+#include "ResultFile.h"
+#include "Checkpoint.h"
+#include "PrimeStream.h"
+#include "Cluster.h"
+#include "SegmentCache.h"
+#include "Pipeline.h"
+#include "AutoTune.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,182 +15,459 @@
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
+#include <charconv>
 
 // Constructor: Load configuration from JSON file
-PrimeFinder::PrimeFinder(const std::string& configFile) {
-    config = loadConfig(configFile);
+// Exits if the file cannot be loaded
+PrimeFinder::PrimeFinder(const std::string& configFile) : configPath(configFile) {
+    ConfigError error;
+    if (!loadConfig(configFile, config, error)) {
+        std::cerr << "Error: " << error.describe() << std::endl;
+        std::cerr << "Please ensure config.json exists in the same directory." << std::endl;
+        exit(1);
+    }
+}
+
+// Constructor: Use a configuration built in code (e.g. by the benchmark
+// or the command line). configFile, if given, is where tuned settings are saved
+PrimeFinder::PrimeFinder(const Config& cfg, const std::string& configFile)
+    : config(cfg), configPath(configFile) {
+}
+
+// Parse a range bound written either as "2^X" or as a plain integer
+// Returns false if the text is not a valid unsigned 64-bit value
+bool PrimeFinder::parseNumber(std::string_view text, uint64_t& value) {
+    if (text.empty()) return false;
+    
+    const char* end = text.data() + text.size();
+    if (text.substr(0, 2) == "2^") {
+        // Extract the exponent from "2^X"
+        int exponent = 0;
+        std::from_chars_result parsed = std::from_chars(text.data() + 2, end, exponent);
+        if (text.size() == 2 || text[2] == '-' || parsed.ec != std::errc() || parsed.ptr != end ||
+            exponent > MAX_EXPONENT) {
+            return false;
+        }
+        value = 1ULL << exponent;
+        return true;
+    }
+    
+    if (text[0] == '-') return false;
+    uint64_t parsedValue = 0;
+    std::from_chars_result parsed = std::from_chars(text.data(), end, parsedValue);
+    if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+    value = parsedValue;
+    return true;
+}
+
+// "file:line:column: message", leaving out the parts that are not known
+std::string ConfigError::describe() const {
+    std::string text = file;
+    if (line > 0) text += (text.empty() ? "" : ":") + std::to_string(line) + ":" + std::to_string(column);
+    return text + (text.empty() ? "" : ": ") + message;
+}
+
+// An int in a config value, quoted or not; false unless it is at least minimum
+static bool readInt(std::string_view text, int minimum, int& value) {
+    int parsedValue = 0;
+    const char* end = text.data() + text.size();
+    std::from_chars_result parsed = std::from_chars(text.data(), end, parsedValue);
+    if (text.empty() || parsed.ec != std::errc() || parsed.ptr != end || parsedValue < minimum) {
+        return false;
+    }
+    value = parsedValue;
+    return true;
+}
+
+static bool readString(std::string_view text, bool quoted, std::string& value) {
+    if (!quoted) return false;
+    value = text;
+    return true;
+}
+
+// A quoted value that must be one of choices
+static bool readChoice(std::string_view text, bool quoted, std::initializer_list<const char*> choices,
+                       std::string& value) {
+    if (!quoted) return false;
+    for (const char* choice : choices) {
+        if (text == choice) {
+            value = choice;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "a, b or c"
+static std::string listChoices(std::initializer_list<const char*> choices) {
+    std::string text;
+    size_t i = 0;
+    for (const char* choice : choices) {
+        if (i > 0) text += (i + 1 == choices.size()) ? " or " : ", ";
+        text += std::string("\"") + choice + "\"";
+        i++;
+    }
+    return text;
+}
+
+// Sets one setting of cfg from its value: a quoted string's characters,
+// escapes already decoded, or an unquoted token. The config file and the
+// command line both come through here, so they accept the same values.
+// On a bad value or an unknown key it returns false and says why in message
+static bool readSetting(std::string_view key, std::string_view text, bool quoted, Config& cfg,
+                        std::string& message) {
+    typedef std::initializer_list<const char*> Choices;
+    static const Choices PRINT_MODES = {"immediate", "wait", "stream", "pipeline"};
+    static const Choices SCHEMES = {"range", "divisibility", "sieve", "auto"};
+    static const Choices SCHEDULERS = {"static", "dynamic"};
+    static const Choices PRIMALITY = {"trial", "miller_rabin"};
+    static const Choices STORES = {"vector", "bitmap", "aggregate"};
+    static const Choices KERNELS = {"auto", "scalar", "avx2", "avx512", "neon"};
+    static const Choices FORMATS = {"varint", "bitmap"};
+    static const Choices SWITCHES = {"on", "off"};
+    static const Choices AFFINITIES = {"none", "compact", "spread"};
+    static const char* POSITIVE_INT = "a positive integer";
+    static const char* POSITIVE_NUMBER = "a positive number (\"2^X\" or an integer)";
+    static const char* STRING = "a string";
+    
+    // What a bad value should have been: one of choices, or expected
+    const Choices* choices = nullptr;
+    const char* expected = nullptr;
+    std::string badCandidate;
+    bool ok = true;
+    if (key == "num_threads") {
+        ok = readInt(text, 1, cfg.num_threads);
+        expected = POSITIVE_INT;
+    } else if (key == "min_number" || key == "max_number") {
+        // The search window accepts "2^X" (X up to MAX_EXPONENT) or a plain integer
+        ok = PrimeFinder::parseNumber(text, key == "min_number" ? cfg.min_number : cfg.max_number);
+        expected = "\"2^X\" (X <= 63) or an integer";
+    } else if (key == "print_mode") {
+        ok = readChoice(text, quoted, *(choices = &PRINT_MODES), cfg.print_mode);
+    } else if (key == "division_scheme") {
+        ok = readChoice(text, quoted, *(choices = &SCHEMES), cfg.division_scheme);
+    } else if (key == "scheduler") {
+        ok = readChoice(text, quoted, *(choices = &SCHEDULERS), cfg.scheduler);
+    } else if (key == "chunk_size") {
+        ok = readInt(text, 1, cfg.chunk_size);
+        expected = POSITIVE_INT;
+    } else if (key == "primality_test") {
+        ok = readChoice(text, quoted, *(choices = &PRIMALITY), cfg.primality_test);
+    } else if (key == "result_store") {
+        ok = readChoice(text, quoted, *(choices = &STORES), cfg.result_store);
+    } else if (key == "divisibility_kernel") {
+        ok = readChoice(text, quoted, *(choices = &KERNELS), cfg.divisibility_kernel);
+    } else if (key == "output_file") {
+        ok = readString(text, quoted, cfg.output_file);
+        expected = STRING;
+    } else if (key == "output_format") {
+        ok = readChoice(text, quoted, *(choices = &FORMATS), cfg.output_format);
+    } else if (key == "checkpoint_file") {
+        ok = readString(text, quoted, cfg.checkpoint_file);
+        expected = STRING;
+    } else if (key == "checkpoint_interval") {
+        ok = PrimeFinder::parseNumber(text, cfg.checkpoint_interval) && cfg.checkpoint_interval > 0;
+        expected = POSITIVE_NUMBER;
+    } else if (key == "cache_dir") {
+        ok = readString(text, quoted, cfg.cache_dir);
+        expected = STRING;
+    } else if (key == "encode_threads") {
+        ok = readInt(text, 1, cfg.encode_threads);
+        expected = POSITIVE_INT;
+    } else if (key == "metrics") {
+        ok = readChoice(text, quoted, *(choices = &SWITCHES), cfg.metrics);
+    } else if (key == "trace_file") {
+        ok = readString(text, quoted, cfg.trace_file);
+        expected = STRING;
+    } else if (key == "affinity") {
+        ok = readChoice(text, quoted, *(choices = &AFFINITIES), cfg.affinity);
+    } else if (key == "cluster_workers") {
+        std::vector<std::string> workers;
+        ok = readString(text, quoted, cfg.cluster_workers) &&
+             (cfg.cluster_workers.empty() ||
+              ClusterCoordinator::parseWorkers(cfg.cluster_workers, workers));
+        expected = "\"host:port,host:port,...\"";
+    } else if (key == "shard_size") {
+        ok = PrimeFinder::parseNumber(text, cfg.shard_size) && cfg.shard_size > 0;
+        expected = POSITIVE_NUMBER;
+    } else if (key == "shard_timeout") {
+        ok = readInt(text, 1, cfg.shard_timeout);
+        expected = POSITIVE_INT;
+    } else if (key == "test_numbers") {
+        // Optional list of candidates to spot check
+        ok = quoted;
+        expected = "a string of comma-separated numbers";
+        std::string_view rest = text;
+        cfg.test_numbers.clear();
+        while (ok && !rest.empty()) {
+            size_t comma = rest.find(',');
+            std::string candidate = SimpleJSON::trim(std::string(rest.substr(0, comma)));
+            rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
+            if (candidate.empty()) continue;
+            uint64_t value;
+            ok = PrimeFinder::parseNumber(candidate, value);
+            if (ok) {
+                cfg.test_numbers.push_back(value);
+            } else {
+                badCandidate = candidate;
+            }
+        }
+    } else {
+        ok = false;
+    }
+    if (ok) return true;
+    
+    message = std::string(key);
+    if (!badCandidate.empty()) {
+        message += " entry \"" + badCandidate + "\" is not a valid number";
+    } else if (choices) {
+        message += " must be " + listChoices(*choices);
+    } else if (expected) {
+        message += std::string(" must be ") + expected;
+    } else {
+        message += " is not a known setting";
+    }
+    return false;
+}
+
+// A command-line value, read as a quoted config value would be
+bool PrimeFinder::parseSetting(const std::string& key, std::string_view value, Config& cfg,
+                               std::string& message) {
+    return readSetting(key, value, true, cfg, message);
+}
+
+// Fills cfg from one parsed config object, in a single pass over its keys.
+// Keys it lacks keep their Config defaults; an unknown key or a bad value
+// is an error pointing at that value. Values are read in place unless they
+// hold escapes to decode
+static bool parseConfigObject(std::string_view content, const SimpleJSON::Object& object,
+                              Config& cfg, ConfigError& error) {
+    std::string decoded;
+    for (const SimpleJSON::Field& field : object.fields) {
+        std::string_view text = field.text;
+        if (field.quoted && text.find('\\') != std::string_view::npos) {
+            decoded = SimpleJSON::decode(text);
+            text = decoded;
+        }
+        if (!readSetting(field.key, text, field.quoted, cfg, error.message)) {
+            SimpleJSON::Error at = SimpleJSON::errorAt(content, field.offset, "");
+            error.line = at.line;
+            error.column = at.column;
+            return false;
+        }
+    }
+    return true;
 }
 
 // FEATURE: Configuration file loading from JSON
-// Reads settings from config.json and populates the Config structure
-// Handles max_number in "2^X" format
-Config PrimeFinder::loadConfig(const std::string& filename) {
-    Config cfg;
-    std::ifstream file(filename);
+// Parses every job of a config document; a document is one object or an
+// array of them. Nothing is printed and nothing exits: the first problem
+// comes back in error with its position
+bool PrimeFinder::parseJobs(std::string_view content, std::vector<Config>& jobs,
+                            ConfigError& error) {
+    std::vector<SimpleJSON::Object> objects;
+    SimpleJSON::Error jsonError;
+    if (!SimpleJSON::parse(content, objects, jsonError)) {
+        error.line = jsonError.line;
+        error.column = jsonError.column;
+        error.message = jsonError.message;
+        return false;
+    }
+    if (objects.empty()) {
+        error.message = "the job array is empty";
+        return false;
+    }
     
+    jobs.assign(objects.size(), Config());
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (!parseConfigObject(content, objects[i], jobs[i], error)) {
+            if (objects.size() > 1) error.message = "job " + std::to_string(i + 1) + ": " + error.message;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the jobs of a config file
+bool PrimeFinder::loadJobs(const std::string& filename, std::vector<Config>& jobs,
+                           ConfigError& error) {
+    error = ConfigError();
+    error.file = filename;
+    std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
-        std::cerr << "Error: Could not open " << filename << std::endl;
-        std::cerr << "Please ensure config.json exists in the same directory." << std::endl;
-        exit(1);
+        error.message = "could not open the file";
+        return false;
     }
     
     // Read entire file content
     std::stringstream buffer;
     buffer << file.rdbuf();
     std::string content = buffer.str();
-    file.close();
-    
-    // Parse JSON using our simple parser
-    cfg.num_threads = SimpleJSON::getInt(content, "num_threads");
-    
-    // Parse max_number - handle "2^X" format
-    std::string maxNumStr = SimpleJSON::getString(content, "max_number");
-    if (maxNumStr.find("2^") == 0) {
-        // Extract the exponent from "2^X"
-        int exponent = std::stoi(maxNumStr.substr(2));
-        cfg.max_number = static_cast<int>(std::pow(2, exponent));
-    } else {
-        // Fallback to direct integer parsing
-        cfg.max_number = SimpleJSON::getInt(content, "max_number");
+    return parseJobs(content, jobs, error);
+}
+
+// Reads a config file that must hold exactly one job
+bool PrimeFinder::loadConfig(const std::string& filename, Config& cfg, ConfigError& error) {
+    std::vector<Config> jobs;
+    if (!loadJobs(filename, jobs, error)) return false;
+    if (jobs.size() != 1) {
+        error.message = "holds " + std::to_string(jobs.size()) + " jobs where one is expected";
+        return false;
     }
-    
-    cfg.print_mode = SimpleJSON::getString(content, "print_mode");
-    cfg.division_scheme = SimpleJSON::getString(content, "division_scheme");
-    
-    return cfg;
+    cfg = jobs[0];
+    return true;
 }
 
 // FEATURE: Save configuration back to JSON file
-// Writes the current config settings to config.json
-void PrimeFinder::saveConfig(const std::string& filename, int exponent) {
+// Writes the config settings to config.json; a power-of-two max_number is
+// kept in "2^X" form. Strings are escaped, so paths with backslashes or
+// quotes load back unchanged. Returns false if the file cannot be written
+bool PrimeFinder::saveConfig(const Config& cfg, const std::string& filename) {
+    auto quoted = [](const std::string& text) { return "\"" + SimpleJSON::encode(text) + "\""; };
     std::ofstream outfile(filename);
     outfile << "{\n";
-    outfile << "    \"num_threads\": " << config.num_threads << ",\n";
-    outfile << "    \"max_number\": \"2^" << exponent << "\",\n";
-    outfile << "    \"print_mode\": \"" << config.print_mode << "\",\n";
-    outfile << "    \"division_scheme\": \"" << config.division_scheme << "\"\n";
+    outfile << "    \"num_threads\": " << cfg.num_threads << ",\n";
+    outfile << "    \"min_number\": " << cfg.min_number << ",\n";
+    uint64_t max = cfg.max_number;
+    if (max != 0 && (max & (max - 1)) == 0) {
+        int exponent = 0;
+        while ((1ULL << exponent) < max) exponent++;
+        outfile << "    \"max_number\": \"2^" << exponent << "\",\n";
+    } else {
+        outfile << "    \"max_number\": " << max << ",\n";
+    }
+    outfile << "    \"print_mode\": " << quoted(cfg.print_mode) << ",\n";
+    outfile << "    \"division_scheme\": " << quoted(cfg.division_scheme) << ",\n";
+    outfile << "    \"scheduler\": " << quoted(cfg.scheduler) << ",\n";
+    outfile << "    \"chunk_size\": " << cfg.chunk_size << ",\n";
+    outfile << "    \"primality_test\": " << quoted(cfg.primality_test) << ",\n";
+    outfile << "    \"result_store\": " << quoted(cfg.result_store) << ",\n";
+    outfile << "    \"divisibility_kernel\": " << quoted(cfg.divisibility_kernel);
+    if (!cfg.output_file.empty()) {
+        outfile << ",\n    \"output_file\": " << quoted(cfg.output_file) << ",\n";
+        outfile << "    \"output_format\": " << quoted(cfg.output_format);
+    }
+    if (!cfg.checkpoint_file.empty()) {
+        outfile << ",\n    \"checkpoint_file\": " << quoted(cfg.checkpoint_file) << ",\n";
+        outfile << "    \"checkpoint_interval\": " << cfg.checkpoint_interval;
+    }
+    if (!cfg.cache_dir.empty()) {
+        outfile << ",\n    \"cache_dir\": " << quoted(cfg.cache_dir);
+    }
+    if (cfg.encode_threads != 1) {
+        outfile << ",\n    \"encode_threads\": " << cfg.encode_threads;
+    }
+    if (cfg.affinity != "none") {
+        outfile << ",\n    \"affinity\": " << quoted(cfg.affinity);
+    }
+    if (!cfg.cluster_workers.empty()) {
+        outfile << ",\n    \"cluster_workers\": " << quoted(cfg.cluster_workers) << ",\n";
+        outfile << "    \"shard_size\": " << cfg.shard_size << ",\n";
+        outfile << "    \"shard_timeout\": " << cfg.shard_timeout;
+    }
+    if (cfg.metrics == "on") {
+        outfile << ",\n    \"metrics\": \"on\"";
+    }
+    if (!cfg.trace_file.empty()) {
+        outfile << ",\n    \"trace_file\": " << quoted(cfg.trace_file);
+    }
+    if (!cfg.test_numbers.empty()) {
+        outfile << ",\n    \"test_numbers\": \"";
+        for (size_t i = 0; i < cfg.test_numbers.size(); i++) {
+            if (i > 0) outfile << ", ";
+            outfile << cfg.test_numbers[i];
+        }
+        outfile << "\"";
+    }
+    outfile << "\n";
     outfile << "}\n";
     outfile.close();
+    return static_cast<bool>(outfile);
 }
 
-// Basic primality test algorithm
-bool PrimeFinder::isPrime(int n) {
-    if (n < 2) return false;
-    if (n == 2) return true;
-    if (n % 2 == 0) return false;
-    
-    int limit = static_cast<int>(std::sqrt(n));
-    for (int i = 3; i <= limit; i += 2) {
-        if (n % i == 0) return false;
+void PrimeFinder::setConfig(const Config& cfg) {
+    config = cfg;
+}
+
+// The engine's share of the configuration. "auto" is not an engine scheme:
+// run() tunes it away before any search that divides by scheme, and the
+// paths that never read the scheme (candidate tests, streams, pipelines and
+// cluster workers) get the engine default
+EngineOptions PrimeFinder::engineOptions(const Config& cfg) {
+    EngineOptions opts;
+    opts.num_threads = cfg.num_threads;
+    if (cfg.division_scheme != "auto") opts.division_scheme = cfg.division_scheme;
+    opts.scheduler = cfg.scheduler;
+    opts.chunk_size = cfg.chunk_size;
+    opts.primality_test = cfg.primality_test;
+    opts.result_store = cfg.result_store;
+    opts.divisibility_kernel = cfg.divisibility_kernel;
+    opts.trace = !cfg.trace_file.empty();
+    opts.affinity = cfg.affinity;
+    return opts;
+}
+
+// The engine is created once and only reconfigured afterwards, so its
+// thread pool and base-prime table survive between searches
+PrimeEngine& PrimeFinder::getEngine() {
+    if (!engine) {
+        engine.reset(new PrimeEngine(engineOptions(config)));
+    } else {
+        engine->setOptions(engineOptions(config));
     }
-    return true;
+    return *engine;
 }
 
 // FEATURE: Immediate printing with thread ID and timestamp
-// Prints result immediately when a prime is found
-void PrimeFinder::printResult(int threadId, int number) {
-    std::lock_guard<std::mutex> lock(print_mutex);
-    
-    // Get current timestamp
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-    
-    std::tm* timeinfo = std::localtime(&time);
-    
-    std::cout << "[Thread-" << threadId << "] "
-              << "[" << std::put_time(timeinfo, "%H:%M:%S")
-              << "." << std::setfill('0') << std::setw(3) << ms.count() << "] "
-              << "Found prime: " << number << std::endl;
-}
-
-// Thread-safe method to add prime to results vector
-void PrimeFinder::addPrime(int number) {
-    std::lock_guard<std::mutex> lock(results_mutex);
-    primes.push_back(number);
-}
-
-// DIVISION SCHEME 1: Range-based division
-// Each thread searches a contiguous range of numbers
-// Example: For 1-1000 with 4 threads: [1-250], [251-500], [501-750], [751-1000]
-void PrimeFinder::searchRange(int threadId, int start, int end) {
-    for (int num = start; num <= end; num++) {
-        if (isPrime(num)) {
-            // FEATURE: Immediate print mode
-            if (config.print_mode == "immediate") {
-                printResult(threadId, num);
-            }
-            addPrime(num);
-        }
-    }
+// Hands the result to the background writer, which stamps, formats and
+// prints it in batches so workers never wait on the console
+void PrimeFinder::printResult(int threadId, uint64_t number) {
+    writer->push(threadId, number);
 }
 
-// Each thread checks a subset of divisors for a single number
-void PrimeFinder::checkDivisibility(int number, const std::vector<int>& divisors, 
-                      DivisibilityResult* result) {
-    for (int divisor : divisors) {
-        if (number % divisor == 0) {
-            std::lock_guard<std::mutex> lock(result->mtx);
-            result->isComposite = true;
-            return;  // Found a divisor, number is composite
+// Decimal digits of an aggregate sum, which may not fit in 64 bits. Long
+// division of its four 32-bit limbs, so it needs no 128-bit arithmetic
+static std::string toDecimal(const PrimeSum& value) {
+    uint64_t high = sumHigh(value), low = sumLow(value);
+    uint32_t limbs[4] = {static_cast<uint32_t>(high >> 32), static_cast<uint32_t>(high),
+                         static_cast<uint32_t>(low >> 32), static_cast<uint32_t>(low)};
+    std::string digits;
+    do {
+        uint64_t remainder = 0;
+        for (uint32_t& limb : limbs) {
+            uint64_t current = (remainder << 32) | limb;
+            limb = static_cast<uint32_t>(current / 10);
+            remainder = current % 10;
         }
-    }
+        digits.insert(digits.begin(), static_cast<char>('0' + remainder));
+    } while (limbs[0] | limbs[1] | limbs[2] | limbs[3]);
+    return digits;
 }
 
-// DIVISION SCHEME 2: Parallel primality test
-// Uses multiple threads to test divisibility of a single number
-bool PrimeFinder::isPrimeParallel(int number) {
-    if (number < 2) return false;
-    if (number == 2) return true;
-    if (number % 2 == 0) return false;
-    
-    int sqrtN = static_cast<int>(std::sqrt(number));
-    std::vector<int> divisors;
-    
-    // Generate odd divisors to test
-    for (int i = 3; i <= sqrtN; i += 2) {
-        divisors.push_back(i);
-    }
-    
-    if (divisors.empty()) return true;
-    
-    // Divide divisors among threads
-    DivisibilityResult result;
-    std::vector<std::thread> threads;
-    int chunkSize = std::max(1, static_cast<int>(divisors.size()) / config.num_threads);
+// FEATURE: Candidate test mode
+// Checks only the numbers listed in test_numbers and reports how long each
+// took, instead of searching a whole range
+void PrimeFinder::runCandidateTests() {
+    PrimeEngine& tester = getEngine();
+    std::cout << "\nTesting " << config.test_numbers.size() << " candidate(s) with "
+              << config.primality_test << "\n";
+    std::cout << std::string(60, '-') << "\n";
     
-    for (int i = 0; i < config.num_threads; i++) {
-        int startIdx = i * chunkSize;
-        int endIdx = (i == config.num_threads - 1) ? divisors.size() : startIdx + chunkSize;
-        
-        if (startIdx >= divisors.size()) break;
-        
-        std::vector<int> chunk(divisors.begin() + startIdx, 
-                              divisors.begin() + endIdx);
+    int primeCount = 0;
+    for (uint64_t candidate : config.test_numbers) {
+        auto begin = std::chrono::steady_clock::now();
+        bool prime = tester.isPrime(candidate);
+        std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - begin;
         
-        threads.emplace_back(&PrimeFinder::checkDivisibility, this, 
-                           number, chunk, &result);
-    }
-    
-    // Wait for all divisibility checks
-    for (auto& thread : threads) {
-        thread.join();
+        // 0 and 1 are neither prime nor composite
+        if (prime) primeCount++;
+        const char* verdict = prime ? " is prime" : (candidate < 2 ? " is not prime" : " is composite");
+        std::cout << "  " << candidate << verdict << " (" << took.count() << " us)\n";
     }
     
-    return !result.isComposite;
-}
-
-// Search using parallel divisibility testing
-void PrimeFinder::searchWithDivisibilityThreads(int threadId, int start, int end) {
-    for (int num = start; num <= end; num++) {
-        if (isPrimeParallel(num)) {
-            if (config.print_mode == "immediate") {
-                printResult(threadId, num);
-            }
-            addPrime(num);
-        }
-    }
+    std::cout << std::string(60, '-') << "\n";
+    std::cout << "  - Primes among candidates: " << primeCount << " of " 
+              << config.test_numbers.size() << "\n";
 }
 
 // FEATURE: Interactive configuration at startup
@@ -215,12 +499,31 @@ void PrimeFinder::configureInteractive(const std::string& configFile) {
                   << config.max_number << "): ";
         std::cin >> exponent;
         
-        if (std::cin.fail() || exponent <= 0 || exponent >= 31) {
+        if (std::cin.fail() || exponent <= 0 || exponent > MAX_EXPONENT) {
+            std::cin.clear();
+            std::cin.ignore(10000, '\n');
+            std::cout << "Invalid input! Please enter an integer between 1 and " 
+                      << MAX_EXPONENT << ".\n\n";
+        } else {
+            config.max_number = 1ULL << exponent;
+            break;
+        }
+    }
+    
+    // Get min number (start of the search window) with validation
+    long long minNumber;
+    while (true) {
+        std::cout << "Enter min number (current: " << config.min_number << "): ";
+        std::cin >> minNumber;
+        
+        if (std::cin.fail() || minNumber < 0 || 
+            static_cast<uint64_t>(minNumber) > config.max_number) {
             std::cin.clear();
             std::cin.ignore(10000, '\n');
-            std::cout << "Invalid input! Please enter an integer between 1 and 30.\n\n";
+            std::cout << "Invalid input! Please enter an integer between 0 and " 
+                      << config.max_number << ".\n\n";
         } else {
-            config.max_number = static_cast<int>(std::pow(2, exponent));
+            config.min_number = static_cast<uint64_t>(minNumber);
             break;
         }
     }
@@ -231,18 +534,24 @@ void PrimeFinder::configureInteractive(const std::string& configFile) {
         std::cout << "\nPrinting Variations:\n";
         std::cout << "  1. Print immediately (with thread ID and timestamp)\n";
         std::cout << "  2. Wait until all threads are done then print\n";
-        std::cout << "Enter choice (1 or 2) (current: " << config.print_mode << "): ";
+        std::cout << "  3. Stream in order while searching (sieve, bounded memory)\n";
+        std::cout << "  4. Pipeline in order, output overlapping the search (bounded memory)\n";
+        std::cout << "Enter choice (1-4) (current: " << config.print_mode << "): ";
         std::cin >> printChoice;
         
-        if (std::cin.fail() || (printChoice != 1 && printChoice != 2)) {
+        if (std::cin.fail() || printChoice < 1 || printChoice > 4) {
             std::cin.clear();
             std::cin.ignore(10000, '\n');
-            std::cout << "\nInvalid input! Please enter either 1 or 2.\n";
+            std::cout << "\nInvalid input! Please enter 1, 2, 3 or 4.\n";
         } else {
             if (printChoice == 1) {
                 config.print_mode = "immediate";
-            } else {
+            } else if (printChoice == 2) {
                 config.print_mode = "wait";
+            } else if (printChoice == 3) {
+                config.print_mode = "stream";
+            } else {
+                config.print_mode = "pipeline";
             }
             break;
         }
@@ -254,121 +563,831 @@ void PrimeFinder::configureInteractive(const std::string& configFile) {
         std::cout << "\nTask Division Schemes:\n";
         std::cout << "  1. Range division (divide search range among threads)\n";
         std::cout << "  2. Divisibility testing (linear search, parallel divisibility check)\n";
-        std::cout << "Enter choice (1 or 2) (current: " << config.division_scheme << "): ";
+        std::cout << "  3. Segmented sieve (each thread sieves cache-sized segments of its range)\n";
+        std::cout << "  4. Auto (calibrate, then save the fastest scheme, threads and chunks)\n";
+        std::cout << "Enter choice (1-4) (current: " << config.division_scheme << "): ";
         std::cin >> divisionChoice;
         
-        if (std::cin.fail() || (divisionChoice != 1 && divisionChoice != 2)) {
+        if (std::cin.fail() || divisionChoice < 1 || divisionChoice > 4) {
             std::cin.clear();
             std::cin.ignore(10000, '\n');
-            std::cout << "\nInvalid input! Please enter either 1 or 2.\n";
+            std::cout << "\nInvalid input! Please enter 1, 2, 3 or 4.\n";
         } else {
             if (divisionChoice == 1) {
                 config.division_scheme = "range";
-            } else {
+            } else if (divisionChoice == 2) {
                 config.division_scheme = "divisibility";
+            } else if (divisionChoice == 3) {
+                config.division_scheme = "sieve";
+            } else {
+                config.division_scheme = "auto";
             }
             break;
         }
     }
     
+    // Get scheduler with validation
+    int schedulerChoice;
+    while (true) {
+        std::cout << "\nScheduling (range and sieve schemes):\n";
+        std::cout << "  1. Static (one contiguous block per thread)\n";
+        std::cout << "  2. Dynamic (threads pull chunks of " << config.chunk_size 
+                  << " numbers as they finish)\n";
+        std::cout << "Enter choice (1 or 2) (current: " << config.scheduler << "): ";
+        std::cin >> schedulerChoice;
+        
+        if (std::cin.fail() || (schedulerChoice != 1 && schedulerChoice != 2)) {
+            std::cin.clear();
+            std::cin.ignore(10000, '\n');
+            std::cout << "\nInvalid input! Please enter either 1 or 2.\n";
+        } else {
+            config.scheduler = (schedulerChoice == 1) ? "static" : "dynamic";
+            break;
+        }
+    }
+    
     // Save updated configuration
-    saveConfig(configFile, exponent);
-    std::cout << "\nConfiguration saved to " << configFile << "\n\n";
+    if (saveConfig(config, configFile)) {
+        std::cout << "\nConfiguration saved to " << configFile << "\n\n";
+    } else {
+        std::cerr << "\nError: could not write " << configFile << "\n\n";
+    }
 }
 
-// Main execution method
-void PrimeFinder::run() {
-    // Record start time (for calculation, not printing yet)
-    auto startTime = std::chrono::high_resolution_clock::now();
-    auto startSystemTime = std::chrono::system_clock::now();
-    auto startTimeT = std::chrono::system_clock::to_time_t(startSystemTime);
-    std::tm* startTm = std::localtime(&startTimeT);
+// Found primes in ascending order; the bitmap is only expanded on request
+std::vector<uint64_t> PrimeFinder::getPrimes() const {
+    return engine ? engine->getPrimes() : std::vector<uint64_t>();
+}
+
+// Starts the background writer for immediate-mode output
+void PrimeFinder::startWriter() {
+    writer.reset(new AsyncWriter());
+    metrics.writerThreads++;
+}
+
+// Flushes any immediate-mode output still queued and stops the writer
+void PrimeFinder::finishWriter() {
+    if (!writer) return;
+    metrics.writerStalls += writer->stallCount();
+    metrics.writerStallSeconds += writer->stallSeconds();
+    writer.reset();
+}
+
+// Searches [low, high] with the engine. In immediate mode the primes are
+// printed as they are found, through the caller's writer if it started
+// one, or else through a fresh one flushed before returning.
+// The window's statistics and trace events are added to metrics
+SearchResult PrimeFinder::searchWindow(uint64_t low, uint64_t high) {
+    PrimeEngine& searcher = getEngine();
+    
+    PrimeCallback callback;
+    bool ownWriter = false;
+    if (config.print_mode == "immediate") {
+        ownWriter = !writer;
+        if (ownWriter) startWriter();
+        callback = [this](int threadId, uint64_t prime) { printResult(threadId, prime); };
+    }
+    
+    SearchResult result = searcher.search(low, high, callback);
+    if (ownWriter) finishWriter();
+    
+    const std::vector<ThreadStats>& windowStats = searcher.getThreadStats();
+    metrics.threads.resize(std::max(metrics.threads.size(), windowStats.size()));
+    for (size_t i = 0; i < windowStats.size(); i++) {
+        ThreadStats& total = metrics.threads[i];
+        total.busySeconds += windowStats[i].busySeconds;
+        total.idleSeconds += windowStats[i].idleSeconds;
+        total.waitSeconds += windowStats[i].waitSeconds;
+        total.chunks += windowStats[i].chunks;
+        total.numbersTested += windowStats[i].numbersTested;
+        total.divisions += windowStats[i].divisions;
+        total.crossings += windowStats[i].crossings;
+        total.primesFound += windowStats[i].primesFound;
+        total.allocations += windowStats[i].allocations;
+    }
+    const std::vector<CacheAligned<std::vector<TraceEvent>>>& trace = searcher.getTrace();
+    for (size_t i = 0; i < trace.size(); i++) {
+        metrics.events.insert(metrics.events.end(), trace[i].begin(), trace[i].end());
+        metrics.eventThreads.insert(metrics.eventThreads.end(), trace[i].size(),
+                                    static_cast<int>(i + 1));
+    }
+    return result;
+}
+
+// Runs the configured search and collects the results, without printing
+// anything except immediate-mode primes. Used by run() and the benchmark
+SearchResult PrimeFinder::search() {
+    metrics = RunMetrics();
+    return searchWindow(config.min_number, config.max_number);
+}
 
+// FEATURE: Checkpointed search
+// Searches what the checkpoint does not cover yet, in checkpoint_interval
+// segments, and records each finished segment before starting the next.
+// Extending a finished run to a larger max_number only searches the new part
+SearchResult PrimeFinder::searchCheckpointed(Checkpoint& checkpoint) {
+    auto startTime = std::chrono::steady_clock::now();
+    metrics = RunMetrics();
+    
+    for (uint64_t low = checkpoint.nextNumber(); low <= config.max_number; ) {
+        uint64_t high = (config.max_number - low < config.checkpoint_interval)
+                            ? config.max_number : low + config.checkpoint_interval - 1;
+        searchWindow(low, high);
+        checkpoint.append(*engine, high);
+        std::cout << "  - Checkpoint: searched up to " << high << " ("
+                  << checkpoint.count() << " primes)" << std::endl;
+        low = high + 1;
+    }
+    
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    SearchResult result;
+    result.primeCount = checkpoint.countUpTo(config.max_number);
+    result.seconds = elapsed.count();
+    return result;
+}
+
+// FEATURE: Auto-tuning (division_scheme "auto")
+// Times short calibration runs at the top of the window and switches the
+// configuration to the fastest scheme, scheduler, chunk size and thread
+// count. Those settings replace "auto" in the config file, if there is one,
+// so later runs start with them and skip the calibration. Returns false if
+// the calibration fails; failing to save the choice is only reported
+bool PrimeFinder::autoTune() {
+    std::cout << "\nAuto-tuning on [" << config.min_number << ", " << config.max_number << "]\n";
+    EngineOptions chosen;
+    try {
+        AutoTuner tuner(engineOptions(config), config.min_number, config.max_number);
+        const CacheInfo& cache = tuner.caches();
+        std::cout << "  - Hardware threads: " << tuner.hardwareThreads() << ", caches L1d "
+                  << cache.l1d / 1024 << " KB, L2 " << cache.l2 / 1024 << " KB, L3 "
+                  << cache.l3 / 1024 << " KB\n";
+        chosen = tuner.run();
+        for (const TuneTrial& trial : tuner.trials()) {
+            std::cout << "      " << std::left << std::setw(13) << trial.options.division_scheme
+                      << std::setw(8) << trial.options.scheduler << std::right
+                      << " chunk " << std::setw(9)
+                      << (trial.options.scheduler == "dynamic" ? trial.options.chunk_size : 0)
+                      << "  threads " << std::setw(3) << trial.options.num_threads << "  "
+                      << static_cast<uint64_t>(trial.numbersPerSecond) << " numbers/s\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    
+    config.division_scheme = chosen.division_scheme;
+    config.scheduler = chosen.scheduler;
+    config.chunk_size = chosen.chunk_size;
+    config.num_threads = chosen.num_threads;
+    std::cout << "  - Chose " << config.division_scheme << ", " << config.scheduler
+              << " scheduler, chunk size " << config.chunk_size << ", "
+              << config.num_threads << " threads\n";
+    
+    if (configPath.empty()) {
+        std::cout << "  - Not saved: no config file in use\n";
+        return true;
+    }
+    // Only the tuned keys change; command-line overrides stay out of the file
+    Config saved;
+    ConfigError error;
+    if (!loadConfig(configPath, saved, error)) {
+        std::cout << "  - Not saved: " << error.describe() << "\n";
+        return true;
+    }
+    saved.division_scheme = config.division_scheme;
+    saved.scheduler = config.scheduler;
+    saved.chunk_size = config.chunk_size;
+    saved.num_threads = config.num_threads;
+    if (saveConfig(saved, configPath)) {
+        std::cout << "  - Saved to " << configPath << "\n";
+    } else {
+        std::cout << "  - Not saved: could not write " << configPath << "\n";
+    }
+    return true;
+}
+
+// FEATURE: Persistent cache
+// Reads the parts of the window that earlier runs cached and searches only
+// the gaps between them. If there were gaps, the whole window is stored as
+// one entry merged with its neighbours. Primes are streamed from the entries
+// and the engine into that entry and the writer, never collected, and one
+// writer prints the whole window in immediate mode, cached primes as Thread-0
+SearchResult PrimeFinder::searchCached(SegmentCache& cache) {
+    auto startTime = std::chrono::steady_clock::now();
+    metrics = RunMetrics();
+    cacheUsage = CacheUsage();
+    getEngine();   // The report reads the engine even if nothing is searched
+    
+    std::vector<SegmentCache::Piece> pieces = cache.plan(config.min_number, config.max_number);
+    std::unique_ptr<SegmentCache::Update> update;
+    if (std::any_of(pieces.begin(), pieces.end(),
+                    [](const SegmentCache::Piece& piece) { return piece.path.empty(); })) {
+        update.reset(new SegmentCache::Update(cache, config.min_number, config.max_number));
+    }
+    if (config.print_mode == "immediate") startWriter();
+    
+    uint64_t primeCount = 0;
+    auto record = [&](uint64_t prime) {
+        if (update) update->add(prime);
+        primeCount++;
+    };
+    for (const SegmentCache::Piece& piece : pieces) {
+        if (piece.path.empty()) {
+            searchWindow(piece.low, piece.high);
+            engine->forEachPrime(record);
+            cacheUsage.searchedNumbers += piece.high - piece.low + 1;
+            continue;
+        }
+        ResultReader reader(piece.path);
+        reader.forEachPrime(piece.low, piece.high, [&](uint64_t prime) {
+            if (writer) writer->push(0, prime);
+            record(prime);
+            return true;
+        });
+        cacheUsage.reusedNumbers += piece.high - piece.low + 1;
+    }
+    finishWriter();
+    if (update) update->commit();
+    cacheUsage.entries = cache.entryCount();
+    
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    SearchResult result;
+    result.primeCount = primeCount;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+// FEATURE: Metrics report
+// One row per thread of the counters the engine kept during the run, then
+// the totals. Rows that did no work are left out
+void PrimeFinder::printMetrics(double seconds) const {
+    std::cout << "\nMetrics:\n";
+    std::cout << "  " << std::left << std::setw(10) << "thread" << std::right
+              << std::setw(14) << "tested" << std::setw(16) << "divisions"
+              << std::setw(14) << "crossings" << std::setw(12) << "primes"
+              << std::setw(10) << "busy_s" << std::setw(10) << "idle_s"
+              << std::setw(10) << "wait_s" << std::setw(10) << "allocs" << "\n";
+    
+    ThreadStats total;
+    auto row = [](const std::string& name, const ThreadStats& stats) {
+        std::cout << "  " << std::left << std::setw(10) << name << std::right
+                  << std::setw(14) << stats.numbersTested << std::setw(16) << stats.divisions
+                  << std::setw(14) << stats.crossings << std::setw(12) << stats.primesFound
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(10) << stats.busySeconds << std::setw(10) << stats.idleSeconds
+                  << std::setw(10) << stats.waitSeconds << std::setw(10) << stats.allocations
+                  << "\n";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    };
+    for (size_t i = 0; i < metrics.threads.size(); i++) {
+        const ThreadStats& stats = metrics.threads[i];
+        if (stats.chunks == 0 && stats.divisions == 0) continue;
+        row("Thread-" + std::to_string(i + 1), stats);
+        total.numbersTested += stats.numbersTested;
+        total.divisions += stats.divisions;
+        total.crossings += stats.crossings;
+        total.primesFound += stats.primesFound;
+        total.busySeconds += stats.busySeconds;
+        total.idleSeconds += stats.idleSeconds;
+        total.waitSeconds += stats.waitSeconds;
+        total.allocations += stats.allocations;
+    }
+    row("total", total);
+    
+    std::cout << "  - Threads spawned: " << engine->threadsSpawned() << " workers, "
+              << metrics.writerThreads << " writers\n";
+    if (metrics.writerThreads > 0) {
+        std::cout << "  - Writer backpressure: " << metrics.writerStalls << " stalls, "
+                  << metrics.writerStallSeconds << " seconds\n";
+    }
+    if (seconds > 0 && total.numbersTested > 0) {
+        std::cout << "  - Tested per second: " << static_cast<uint64_t>(total.numbersTested / seconds)
+                  << "\n";
+    }
+}
+
+// FEATURE: Trace export
+// Writes every chunk of the run as a complete ("X") event in the Chrome
+// trace-event JSON format, loadable in chrome://tracing or Perfetto; each
+// worker shows up as its own track, timed in microseconds
+void PrimeFinder::writeTrace() const {
+    std::ofstream out(config.trace_file);
+    if (!out) {
+        std::cerr << "Error: could not write " << config.trace_file << std::endl;
+        return;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < metrics.threads.size(); i++) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (i + 1)
+            << ",\"args\":{\"name\":\"Thread-" << (i + 1) << "\"}},\n";
+    }
+    for (size_t i = 0; i < metrics.events.size(); i++) {
+        const TraceEvent& event = metrics.events[i];
+        out << "{\"name\":\"" << config.division_scheme << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << metrics.eventThreads[i] << ",\"ts\":" << event.startMicros
+            << ",\"dur\":" << event.durationMicros << ",\"args\":{\"low\":" << event.low
+            << ",\"high\":" << event.high << ",\"primes\":" << event.primes << "}},\n";
+    }
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"PrimeFinder\"}}\n";
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    std::cout << "  - Trace: " << config.trace_file << " (" << metrics.events.size() << " events)\n";
+}
+
+// Configuration block printed before every search
+void PrimeFinder::printConfiguration(const Checkpoint* checkpoint) const {
+    bool stream = (config.print_mode == "stream");
     std::cout << "\nStarting Prime Number Search\n";
     std::cout << "Configuration:\n";
     std::cout << "  - Number of threads: " << config.num_threads << "\n";
-    std::cout << "  - Max number: " << config.max_number 
-              << " (2^" << static_cast<int>(std::log2(config.max_number)) << ")\n";
+    if (config.affinity != "none") {
+        std::vector<std::vector<int>> nodes = Affinity::nodes();
+        std::vector<int> cpus = Affinity::placement(config.affinity, config.num_threads);
+        std::cout << "  - Affinity: " << config.affinity << " over " << nodes.size()
+                  << " NUMA node(s), CPUs";
+        for (size_t i = 0; i < cpus.size(); i++) std::cout << (i > 0 ? "," : " ") << cpus[i];
+        std::cout << "\n";
+    }
+    std::cout << "  - Search range: " << config.min_number << " to " << config.max_number << "\n";
     std::cout << "  - Print mode: " << config.print_mode << "\n";
+    if (stream) {
+        // Streams always sieve, segment by segment, and store nothing
+        std::cout << "  - Division scheme: sieve (" << PrimeStream::DEFAULT_SEGMENT_SIZE
+                  << "-number segments, in order)\n";
+        std::cout << std::string(60, '-') << "\n";
+        return;
+    }
+    if (config.print_mode == "pipeline") {
+        // The test stage checks wheel candidates one by one, like the range scheme
+        std::cout << "  - Division scheme: pipeline (" << PrimePipeline::BATCH_NUMBERS
+                  << "-number batches, " << config.encode_threads << " encoder threads)\n";
+        std::cout << "  - Primality test: " << config.primality_test << "\n";
+        std::cout << std::string(60, '-') << "\n";
+        return;
+    }
+    if (!config.cluster_workers.empty()) {
+        // Cluster workers always sieve their shards, in order
+        std::cout << "  - Division scheme: sieve (sharded, " << config.shard_size
+                  << "-number shards)\n";
+        std::cout << "  - Cluster workers: " << config.cluster_workers << " (dropped after "
+                  << config.shard_timeout << " s without an answer)\n";
+        std::cout << std::string(60, '-') << "\n";
+        return;
+    }
     std::cout << "  - Division scheme: " << config.division_scheme << "\n";
+    if (config.division_scheme == "range") {
+        std::cout << "  - Primality test: " << config.primality_test << "\n";
+    }
+    std::cout << "  - Scheduler: " << config.scheduler;
+    if (config.scheduler == "dynamic") std::cout << " (chunk size " << config.chunk_size << ")";
+    std::cout << "\n";
+    std::cout << "  - Result store: " << config.result_store << "\n";
+    if (config.division_scheme == "divisibility" ||
+        (config.division_scheme == "range" && config.primality_test == "trial")) {
+        std::cout << "  - Divisibility kernel: " << DivisibilityKernel::name(
+                         DivisibilityKernel::select(config.divisibility_kernel)) << "\n";
+    }
+    if (!config.cache_dir.empty()) std::cout << "  - Cache: " << config.cache_dir << "\n";
+    if (checkpoint) {
+        std::cout << "  - Checkpoint: " << config.checkpoint_file;
+        if (checkpoint->resumed()) {
+            std::cout << " (resuming at " << checkpoint->nextNumber() << ", "
+                      << checkpoint->count() << " primes recorded)";
+        }
+        std::cout << "\n";
+    }
     std::cout << std::string(60, '-') << "\n";
+}
+
+// The local calendar time now; a copy, since localtime reuses its buffer
+static std::tm localNow() {
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    return *std::localtime(&now);
+}
+
+// Opening lines of the summary every mode prints after its search
+static void printSummary(uint64_t totalPrimes, double seconds) {
+    std::cout << std::string(60, '-') << "\n";
+    std::cout << "\nSummary:\n";
+    std::cout << "  - Total primes found: " << totalPrimes << "\n";
+    std::cout << "  - Execution time: " << seconds << " seconds\n";
+}
+
+// The first primes found, and "..." if there were more
+static void printFirstPrimes(const std::vector<uint64_t>& firstPrimes, uint64_t totalPrimes) {
+    std::cout << "  - Primes: ";
+    for (size_t i = 0; i < firstPrimes.size(); i++) {
+        std::cout << (i > 0 ? ", " : "") << firstPrimes[i];
+    }
+    if (totalPrimes > firstPrimes.size()) std::cout << "...";
+    std::cout << std::endl;
+}
+
+// FEATURE: Print start and end timestamps at the end
+static void printTimestamps(const std::tm& startTm, const std::tm& endTm) {
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "START TIME: " << std::put_time(&startTm, "%Y-%m-%d %H:%M:%S") << "\n";
+    std::cout << "END TIME:   " << std::put_time(&endTm, "%Y-%m-%d %H:%M:%S") << "\n";
+    std::cout << std::string(60, '=') << "\n";
+}
+
+// FEATURE: Stream mode printing
+// Primes are printed in ascending order while the workers keep sieving
+// ahead through a bounded ring, so nothing is collected and memory does not
+// grow with the range. output_file, if set, is written on the fly
+bool PrimeFinder::runStream() {
+    std::tm startTm = localNow();
+    printConfiguration(nullptr);
     
-    std::vector<std::thread> threads;
-    
-    // FEATURE: Division scheme selection
-    if (config.division_scheme == "range") {
-        // Range division: Split the number range among threads
-        int rangeSize = config.max_number / config.num_threads;
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t totalPrimes = 0;
+    std::vector<uint64_t> firstPrimes;
+    uint64_t fileBytes = 0;
+    try {
+        std::unique_ptr<ResultWriter> file;
+        if (!config.output_file.empty()) {
+            ResultEncoding encoding = RESULT_VARINT;
+            ResultWriter::parseEncoding(config.output_format, encoding);
+            file.reset(new ResultWriter(config.output_file, encoding,
+                                        config.min_number, config.max_number));
+        }
         
-        for (int i = 0; i < config.num_threads; i++) {
-            int start = i * rangeSize + 1;
-            int end = (i == config.num_threads - 1) ? 
-                     config.max_number : (i + 1) * rangeSize;
-            
-            threads.emplace_back(&PrimeFinder::searchRange, this, 
-                                i + 1, start, end);
+        PrimeStream stream(getEngine(), config.min_number, config.max_number);
+        uint64_t prime;
+        while (stream.next(prime)) {
+            std::cout << "Prime: " << prime << '\n';
+            if (file) file->add(prime);
+            if (firstPrimes.size() < 20) firstPrimes.push_back(prime);
+            totalPrimes++;
+        }
+        std::cout.flush();
+        if (file) fileBytes = file->finish();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    
+    std::tm endTm = localNow();
+    
+    printSummary(totalPrimes, elapsed.count());
+    if (!config.output_file.empty()) {
+        std::cout << "  - Results file: " << config.output_file << " (" << config.output_format
+                  << ", " << fileBytes << " bytes)\n";
+    }
+    printFirstPrimes(firstPrimes, totalPrimes);
+    
+    printTimestamps(startTm, endTm);
+    return true;
+}
+
+// FEATURE: Pipeline mode printing
+// Generation, testing, formatting and printing run as separate stages over
+// bounded batch queues, so printing overlaps the search instead of
+// following it and memory stays bounded. output_file, if set, is written
+// by the output stage
+bool PrimeFinder::runPipeline() {
+    std::tm startTm = localNow();
+    printConfiguration(nullptr);
+    
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t totalPrimes = 0;
+    std::vector<uint64_t> firstPrimes;
+    uint64_t fileBytes = 0;
+    std::vector<PipelineStageStats> stages;
+    try {
+        std::unique_ptr<ResultWriter> file;
+        if (!config.output_file.empty()) {
+            ResultEncoding encoding = RESULT_VARINT;
+            ResultWriter::parseEncoding(config.output_format, encoding);
+            file.reset(new ResultWriter(config.output_file, encoding,
+                                        config.min_number, config.max_number));
         }
-    } 
-    else {
-        // Divisibility division: Parallel testing of each number
-        int rangeSize = config.max_number / config.num_threads;
         
-        for (int i = 0; i < config.num_threads; i++) {
-            int start = i * rangeSize + 1;
-            int end = (i == config.num_threads - 1) ? 
-                     config.max_number : (i + 1) * rangeSize;
-            
-            threads.emplace_back(&PrimeFinder::searchWithDivisibilityThreads, 
-                                this, i + 1, start, end);
+        PrimePipeline pipeline(getEngine(), config.min_number, config.max_number,
+                               config.encode_threads);
+        totalPrimes = pipeline.run([&](const std::vector<uint64_t>& primes, const std::string& text) {
+            std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+            for (uint64_t prime : primes) {
+                if (file) file->add(prime);
+                if (firstPrimes.size() < 20) firstPrimes.push_back(prime);
+            }
+        });
+        std::cout.flush();
+        if (file) fileBytes = file->finish();
+        stages = pipeline.stageStats();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    
+    std::tm endTm = localNow();
+    
+    printSummary(totalPrimes, elapsed.count());
+    if (!config.output_file.empty()) {
+        std::cout << "  - Results file: " << config.output_file << " (" << config.output_format
+                  << ", " << fileBytes << " bytes)\n";
+    }
+    printFirstPrimes(firstPrimes, totalPrimes);
+    
+    // Busy against blocked time shows which stage limits the others
+    std::cout << "  - Stages:\n";
+    for (const PipelineStageStats& stage : stages) {
+        std::cout << "      " << stage.name << ": " << stage.threads << " threads, "
+                  << stage.batches << " batches, " << stage.busySeconds << " s busy, "
+                  << stage.waitSeconds << " s waiting\n";
+    }
+    
+    printTimestamps(startTm, endTm);
+    return true;
+}
+
+// FEATURE: Cluster mode
+// The window is split into shard_size shards that worker processes on
+// other hosts search with their own engines. Only the count and, with
+// output_file, the merged result file come back; nothing is listed
+bool PrimeFinder::runCluster() {
+    std::tm startTm = localNow();
+    printConfiguration(nullptr);
+    
+    ClusterResult result;
+    try {
+        std::vector<std::string> workers;
+        ClusterCoordinator::parseWorkers(config.cluster_workers, workers);
+        ResultEncoding encoding = RESULT_VARINT;
+        ResultWriter::parseEncoding(config.output_format, encoding);
+        ClusterCoordinator coordinator(workers, config.min_number, config.max_number,
+                                       config.shard_size, config.output_file, encoding,
+                                       config.shard_timeout);
+        result = coordinator.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    
+    std::tm endTm = localNow();
+    
+    printSummary(result.primeCount, result.seconds);
+    std::cout << "  - Shards: " << result.shards << " (" << result.retries << " retried, "
+              << result.duplicates << " straggler duplicates)\n";
+    if (!config.output_file.empty()) {
+        std::cout << "  - Results file: " << config.output_file << " (" << config.output_format
+                  << ", " << result.fileBytes << " bytes)\n";
+    }
+    std::cout << "  - Workers:\n";
+    for (const ClusterWorkerStats& worker : result.workers) {
+        std::cout << "      " << worker.address << ": " << worker.shards << " shards, "
+                  << worker.busySeconds << " seconds";
+        if (worker.threads > 0) std::cout << " (" << worker.threads << " threads)";
+        if (worker.failed) std::cout << " [failed]";
+        std::cout << "\n";
+    }
+    
+    printTimestamps(startTm, endTm);
+    return true;
+}
+
+int PrimeFinder::serve(const std::string& host, uint16_t port) {
+    try {
+        ClusterWorker(getEngine()).serve(host, port);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+    return 1;
+}
+
+// Why cfg combines its mode with settings that mode cannot honour, or ""
+// if it does not. Candidate tests, cluster, stream and pipeline runs each
+// bypass the checkpoint, cache, metrics and trace code of a plain search,
+// so those settings are refused rather than silently dropped
+static std::string modeConflict(const Config& cfg) {
+    bool streaming = (cfg.print_mode == "stream" || cfg.print_mode == "pipeline");
+    std::string mode;
+    std::vector<std::string> refused;
+    auto refuse = [&refused](bool given, const std::string& setting) {
+        if (given) refused.push_back(setting);
+    };
+    if (!cfg.test_numbers.empty()) {
+        mode = "test_numbers";
+        refuse(!cfg.cluster_workers.empty(), "cluster_workers");
+        refuse(streaming, "print_mode \"" + cfg.print_mode + "\"");
+        refuse(!cfg.output_file.empty(), "output_file");
+    } else if (!cfg.cluster_workers.empty()) {
+        mode = "cluster_workers";
+        refuse(cfg.print_mode != "wait", "print_mode \"" + cfg.print_mode + "\"");
+        refuse(cfg.result_store == "aggregate", "result_store \"aggregate\"");
+    } else if (streaming) {
+        mode = "print_mode \"" + cfg.print_mode + "\"";
+        refuse(cfg.result_store == "aggregate", "result_store \"aggregate\"");
+    } else {
+        // A plain search: aggregate mode keeps no primes, so there is
+        // nothing to save or list
+        if (cfg.result_store == "aggregate" && (!cfg.checkpoint_file.empty() ||
+                                                !cfg.output_file.empty() || !cfg.cache_dir.empty())) {
+            return "result_store \"aggregate\" keeps no primes, so it cannot be combined "
+                   "with output_file, checkpoint_file or cache_dir";
+        }
+        if (!cfg.cache_dir.empty() && !cfg.checkpoint_file.empty()) {
+            return "cache_dir and checkpoint_file cannot be used together";
+        }
+        return std::string();
+    }
+    refuse(!cfg.checkpoint_file.empty(), "checkpoint_file");
+    refuse(!cfg.cache_dir.empty(), "cache_dir");
+    refuse(cfg.metrics == "on", "metrics \"on\"");
+    refuse(!cfg.trace_file.empty(), "trace_file");
+    if (refused.empty()) return std::string();
+    
+    std::string text = mode + " cannot be combined with ";
+    for (size_t i = 0; i < refused.size(); i++) {
+        if (i > 0) text += (i + 1 == refused.size()) ? " or " : ", ";
+        text += refused[i];
+    }
+    return text;
+}
+
+// Checks what parsing one key at a time cannot: the search window, the
+// cluster shard count, and settings the chosen mode cannot honour. Touches
+// no file, so a job array can be checked in full before its first job runs
+bool PrimeFinder::validate(const Config& cfg, ConfigError& error) {
+    if (cfg.min_number > cfg.max_number || cfg.max_number > (1ULL << MAX_EXPONENT)) {
+        error.message = "min_number must not exceed max_number, and max_number must not exceed 2^" +
+                        std::to_string(MAX_EXPONENT);
+        return false;
+    }
+    if (!cfg.cluster_workers.empty() &&
+        ClusterCoordinator::shardCount(cfg.min_number, cfg.max_number, cfg.shard_size) >
+            ClusterCoordinator::MAX_SHARDS) {
+        error.message = "shard_size " + std::to_string(cfg.shard_size) +
+                        " splits the window into more than 2^24 shards";
+        return false;
+    }
+    error.message = modeConflict(cfg);
+    return error.message.empty();
+}
+
+// Main execution method
+// Returns false, after printing why, if the configuration is invalid or
+// the search could not be carried out; nothing here exits the process
+bool PrimeFinder::run() {
+    ConfigError error;
+    if (!validate(config, error)) {
+        std::cerr << "Error: " << error.describe() << std::endl;
+        return false;
+    }
+    if (!config.test_numbers.empty()) {
+        runCandidateTests();
+        return true;
+    }
+    if (!config.cluster_workers.empty()) return runCluster();
+    if (config.division_scheme == "auto" && !autoTune()) return false;
+    if (config.print_mode == "stream") return runStream();
+    if (config.print_mode == "pipeline") return runPipeline();
+    
+    // Aggregate mode keeps no primes, so there is nothing to list
+    bool aggregate = (config.result_store == "aggregate");
+    
+    std::unique_ptr<SegmentCache> cache;
+    if (!config.cache_dir.empty()) {
+        try {
+            cache.reset(new SegmentCache(config.cache_dir));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
         }
     }
     
-    // Wait for all threads to complete
-    for (auto& thread : threads) {
-        thread.join();
+    std::unique_ptr<Checkpoint> checkpoint;
+    if (!config.checkpoint_file.empty()) {
+        try {
+            checkpoint.reset(new Checkpoint(config.checkpoint_file, config.min_number));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
     }
     
+    // Record start time
+    std::tm startTm = localNow();
+    printConfiguration(checkpoint.get());
+    
+    SearchResult result;
+    try {
+        if (checkpoint) {
+            result = searchCheckpointed(*checkpoint);
+        } else if (cache) {
+            result = searchCached(*cache);
+        } else {
+            result = search();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    uint64_t totalPrimes = result.primeCount;
+    
     // Record end time
-    auto endTime = std::chrono::high_resolution_clock::now();
-    auto endSystemTime = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed = endTime - startTime;
-    auto endTimeT = std::chrono::system_clock::to_time_t(endSystemTime);
-    std::tm* endTm = std::localtime(&endTimeT);
+    std::tm endTm = localNow();
+    
+    // Every found prime in ascending order, from whichever store holds them;
+    // fn returns false to stop early
+    auto forEachResult = [&](auto fn) {
+        if (checkpoint) {
+            checkpoint->forEachPrime(config.max_number, fn);
+        } else if (cache) {
+            // Every piece is cached once the search has stored its gaps
+            for (const SegmentCache::Piece& piece : cache->plan(config.min_number,
+                                                                config.max_number)) {
+                bool more = true;
+                ResultReader(piece.path).forEachPrime(piece.low, piece.high,
+                    [&](uint64_t prime) { return more = fn(prime); });
+                if (!more) return;
+            }
+        } else if (engine->bitmap()) {
+            for (uint64_t prime : *engine->bitmap()) if (!fn(prime)) return;
+        } else {
+            for (uint64_t prime : engine->primeList()) if (!fn(prime)) return;
+        }
+    };
     
     // FEATURE: Wait mode printing
     // Print all results after threads complete
-    if (config.print_mode == "wait") {
+    if (config.print_mode == "wait" && !aggregate) {
         std::cout << "\nAll threads completed. Results:\n";
         std::cout << std::string(60, '-') << "\n";
         
-        // Sort primes for better readability
-        std::sort(primes.begin(), primes.end());
-        
-        for (int prime : primes) {
+        forEachResult([](uint64_t prime) {
             std::cout << "Prime: " << prime << std::endl;
-        }
+            return true;
+        });
     }
     
     // Summary statistics
-    std::cout << std::string(60, '-') << "\n";
-    std::cout << "\nSummary:\n";
-    std::cout << "  - Total primes found: " << primes.size() << "\n";
-    std::cout << "  - Execution time: " << elapsed.count() << " seconds\n";
+    printSummary(totalPrimes, result.seconds);
+    if (cache) {
+        std::cout << "  - Cache: " << cacheUsage.reusedNumbers << " numbers reused, "
+                  << cacheUsage.searchedNumbers << " searched (" << cacheUsage.entries
+                  << " entries in " << config.cache_dir << ")\n";
+    } else if (!checkpoint && engine->bitmap()) {
+        std::cout << "  - Bitmap size: " << engine->bitmap()->memoryBytes() << " bytes\n";
+    }
+    
+    // FEATURE: Aggregate mode
+    // Totals the workers kept while searching, in place of any listing
+    if (aggregate) {
+        const PrimeAggregate& totals = engine->aggregate();
+        std::cout << "  - Sum of primes: " << toDecimal(totals.sum) << "\n";
+        std::cout << "  - Twin prime pairs: " << totals.twinPairs << "\n";
+        if (totals.count > 0) {
+            std::cout << "  - Smallest prime: " << totals.smallest << "\n";
+            std::cout << "  - Largest prime: " << totals.largest << "\n";
+        }
+    }
+    
+    // FEATURE: Binary result file
+    if (!config.output_file.empty()) {
+        try {
+            ResultEncoding encoding = RESULT_VARINT;
+            ResultWriter::parseEncoding(config.output_format, encoding);
+            ResultWriter file(config.output_file, encoding, config.min_number, config.max_number);
+            forEachResult([&file](uint64_t prime) { file.add(prime); return true; });
+            uint64_t bytes = file.finish();
+            std::cout << "  - Results file: " << config.output_file << " (" << config.output_format
+                      << ", " << bytes << " bytes)\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+    }
     
     // Show first 20 primes
-    std::cout << "  - Primes: ";
-    std::sort(primes.begin(), primes.end());
-    int displayCount = std::min(20, static_cast<int>(primes.size()));
-    for (int i = 0; i < displayCount; i++) {
-        std::cout << primes[i];
-        if (i < displayCount - 1) std::cout << ", ";
+    if (!aggregate) {
+        std::cout << "  - Primes: ";
+        int shown = 0;
+        forEachResult([&shown](uint64_t prime) {
+            if (shown == 20) return false;
+            if (shown > 0) std::cout << ", ";
+            std::cout << prime;
+            shown++;
+            return true;
+        });
+        if (totalPrimes > 20) std::cout << "...";
+        std::cout << std::endl;
     }
-    if (primes.size() > 20) std::cout << "...";
-    std::cout << std::endl;
     
-    // FEATURE: Print start and end timestamps at the end
-    std::cout << "\n" << std::string(60, '=') << "\n";
-    std::cout << "START TIME: " << std::put_time(startTm, "%Y-%m-%d %H:%M:%S") << "\n";
-    std::cout << "END TIME:   " << std::put_time(endTm, "%Y-%m-%d %H:%M:%S") << "\n";
-    std::cout << std::string(60, '=') << "\n";
-}
\ No newline at end of file
+    // Per-thread busy time, to check how evenly the work was balanced
+    const std::vector<ThreadStats>& threadStats = metrics.threads;
+    std::cout << "  - Thread busy time:\n";
+    for (size_t i = 0; i < threadStats.size(); i++) {
+        if (threadStats[i].chunks == 0) continue;
+        std::cout << "      Thread-" << (i + 1) << ": " << threadStats[i].busySeconds
+                  << " seconds (" << threadStats[i].chunks << " chunks)\n";
+    }
+    
+    if (config.metrics == "on") printMetrics(result.seconds);
+    if (!config.trace_file.empty()) writeTrace();
+    
+    printTimestamps(startTm, endTm);
+    return true;
+}
@@ -5,51 +5,148 @@
 
 #include <vector>
 #include <string>
-#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <string_view>
+#include "PrimeEngine.h"
+#include "AsyncWriter.h"
 
 // Structure to hold configuration settings from config file
+// Defaults apply to keys missing from config.json and to configs built in code
 struct Config {
-    int num_threads;      // Number of threads to create (x)
-    int max_number;       // Maximum number to search for primes (calculated from 2^X)
-    std::string print_mode;      // "immediate" or "wait"
-    std::string division_scheme; // "range" or "divisibility"
+    int num_threads = 1;         // Number of threads to create (x)
+    uint64_t min_number = 1;     // Lowest number to search (defaults to 1)
+    uint64_t max_number = 1ULL << 16; // Maximum number to search for primes (calculated from 2^X)
+    std::string print_mode = "wait";        // "immediate", "wait", "stream" (in order, bounded memory) or "pipeline" (staged, in order)
+    std::string division_scheme = "range";  // "range", "divisibility", "sieve" or "auto" (calibrate, then save the choice)
+    std::string scheduler = "static";       // "static" (one block per thread) or "dynamic" (pull chunks)
+    int chunk_size = 8192;                  // Numbers per chunk claimed by a dynamic worker
+    std::string primality_test = "trial";   // isPrime backend: "trial" or "miller_rabin"
+    std::vector<uint64_t> test_numbers;     // If set, only these candidates are tested
+    std::string result_store = "vector";    // "vector" (list of primes), "bitmap" (odd-only bitmap) or "aggregate" (totals only)
+    std::string divisibility_kernel = "auto"; // Trial division kernel: "auto", "scalar", "avx2", "avx512" or "neon"
+    std::string output_file;                // If set, results are also written here in binary
+    std::string output_format = "varint";   // Binary encoding: "varint" (deltas) or "bitmap"
+    std::string checkpoint_file;            // If set, progress is saved here and resumed from
+    uint64_t checkpoint_interval = 1ULL << 26; // Numbers searched between checkpoints
+    std::string cache_dir;                  // If set, searched ranges are cached here across runs
+    int encode_threads = 1;                 // Pipeline mode: threads formatting the output
+    std::string metrics = "off";            // "on" prints a per-thread metrics report
+    std::string trace_file;                 // If set, a Chrome trace of the chunks is written here
+    std::string affinity = "none";          // Worker placement: "none", "compact" or "spread" over NUMA nodes
+    std::string cluster_workers;            // If set, "host:port,..." workers the search is sharded over
+    uint64_t shard_size = 1ULL << 32;       // Numbers per cluster shard
+    int shard_timeout = 600;                // Seconds a cluster worker may stay silent before its shard is re-queued
 };
 
+// Why a config file could not be loaded. line and column point at the
+// offending text, counting from 1, or are 0 when the problem has no position
+struct ConfigError {
+    std::string file;
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+    
+    // "file:line:column: message"
+    std::string describe() const;
+};
+
+// Instrumentation gathered over every window of one run
+struct RunMetrics {
+    std::vector<ThreadStats> threads;       // Summed per thread over the windows
+    std::vector<TraceEvent> events;         // Trace events of every window, with their thread
+    std::vector<int> eventThreads;
+    uint64_t writerStalls = 0;              // Immediate mode: pushes that found the queue full
+    double writerStallSeconds = 0;
+    int writerThreads = 0;                  // Background writers started
+};
+
+class Checkpoint;
+class SegmentCache;
+
+// Where the primes of a cached run came from
+struct CacheUsage {
+    uint64_t reusedNumbers = 0;             // Read back from cache entries
+    uint64_t searchedNumbers = 0;           // Searched and stored as new entries
+    size_t entries = 0;                     // Entries in the cache afterwards
+};
+
+// Console front end: loads and saves config.json, prompts for settings
+// and reports results. The searching itself is done by PrimeEngine
 class PrimeFinder {
 private:
     Config config;
-    std::vector<int> primes;          // Stores all found prime numbers
-    std::mutex results_mutex;         // Protects the primes vector from race conditions
-    std::mutex print_mutex;           // Protects console output from interleaving
-    
-    // Helper structure for divisibility testing
-    struct DivisibilityResult {
-        bool isComposite = false;  // True if number is definitely not prime
-        std::mutex mtx;
-    };
+    std::string configPath;                 // File the config came from, if any
+    std::unique_ptr<PrimeEngine> engine;    // Created on first use, then kept warm
+    std::unique_ptr<AsyncWriter> writer;    // Batches immediate-mode output off the workers
+    RunMetrics metrics;                     // Of the search run() or search() last started
+    CacheUsage cacheUsage;
     
     // Configuration management
-    Config loadConfig(const std::string& filename);
-    void saveConfig(const std::string& filename, int exponent);
+    bool autoTune();
+    static EngineOptions engineOptions(const Config& cfg);
+    PrimeEngine& getEngine();
     
-    // Prime checking algorithms
-    bool isPrime(int n);
-    bool isPrimeParallel(int number);
+    // FEATURE: Immediate printing with thread ID and timestamp
+    void printResult(int threadId, uint64_t number);
+    void runCandidateTests();
     
-    // Thread-safe operations
-    void printResult(int threadId, int number);
-    void addPrime(int number);
-    
-    // Division scheme implementations
-    void searchRange(int threadId, int start, int end);
-    void searchWithDivisibilityThreads(int threadId, int start, int end);
-    void checkDivisibility(int number, const std::vector<int>& divisors, 
-                          DivisibilityResult* result);
+    void printConfiguration(const Checkpoint* checkpoint) const;
+    void startWriter();
+    void finishWriter();
+    bool runStream();
+    bool runPipeline();
+    bool runCluster();
+    SearchResult searchWindow(uint64_t low, uint64_t high);
+    SearchResult searchCheckpointed(Checkpoint& checkpoint);
+    SearchResult searchCached(SegmentCache& cache);
+    void printMetrics(double seconds) const;
+    void writeTrace() const;
     
 public:
+    // Largest supported exponent X for max_number = 2^X
+    static const int MAX_EXPONENT = 63;
+    
     PrimeFinder(const std::string& configFile);
+    explicit PrimeFinder(const Config& cfg, const std::string& configFile = std::string());
+    
+    // Configuration parsing, shared with the command line front end. These
+    // never print or exit: they return false and describe the problem in error.
+    // A config document is one job object or an array of them
+    static bool parseJobs(std::string_view content, std::vector<Config>& jobs, ConfigError& error);
+    static bool loadJobs(const std::string& filename, std::vector<Config>& jobs, ConfigError& error);
+    // Fails unless the file holds exactly one job
+    static bool loadConfig(const std::string& filename, Config& cfg, ConfigError& error);
+    // Writes cfg as a single-job config file that loadConfig reads back
+    // unchanged; false if the file cannot be written
+    static bool saveConfig(const Config& cfg, const std::string& filename);
+    // Checks a job as a whole (its window and the settings its mode can
+    // honour) without touching any file; false with the problem in error
+    static bool validate(const Config& cfg, ConfigError& error);
+    static bool parseNumber(std::string_view text, uint64_t& value);
+    // Sets the config key to a value given as text, e.g. on the command
+    // line, with the config file's rules; false with the problem in message
+    static bool parseSetting(const std::string& key, std::string_view value, Config& cfg,
+                             std::string& message);
+    
     void configureInteractive(const std::string& configFile);
-    void run();
+    // Validates and runs the configured job; false, after printing the
+    // reason, if it is invalid or fails part way
+    bool run();
+    
+    // Replaces the configuration, keeping the engine and its pool warm for
+    // the next run()
+    void setConfig(const Config& cfg);
+    
+    // Serves cluster shards on host:port with this finder's engine; never
+    // returns unless the address cannot be opened
+    int serve(const std::string& host, uint16_t port);
+    
+    // Runs the configured search silently (no listing or summary)
+    SearchResult search();
+    
+    // Found primes in ascending order, materialized from the bitmap if needed
+    std::vector<uint64_t> getPrimes() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "PrimeStream.h"
+#include <algorithm>
+#include <stdexcept>
+
+// Starts one producer per pool worker; sieving begins straight away
+PrimeStream::PrimeStream(PrimeEngine& searchEngine, uint64_t lowNumber, uint64_t highNumber,
+                         uint64_t segmentNumbers)
+    : engine(searchEngine), low(lowNumber), high(highNumber), segmentSize(segmentNumbers) {
+    if (low > high || high > PrimeEngine::MAX_NUMBER || segmentSize == 0) {
+        throw std::invalid_argument("PrimeStream: low must not exceed high, high must not exceed "
+                                    "2^63, segment size must be positive");
+    }
+    numSegments = (high - low) / segmentSize + 1;
+    ring.resize(2 * static_cast<size_t>(engine.pool->size()));
+
+    engine.computeBasePrimes(static_cast<uint32_t>(PrimeEngine::isqrt(high)));
+    for (int i = 0; i < engine.pool->size(); i++) {
+        engine.pool->submit([this] { produce(); });
+    }
+}
+
+// Stops the producers, even if the reader quit early, and waits for them
+PrimeStream::~PrimeStream() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    slotFree.notify_all();
+    engine.pool->wait();
+}
+
+// Worker loop: claim the next segment, wait until its slot is free (the
+// reader has finished the segment a full ring earlier), then sieve into it.
+// Segments are claimed in order and the oldest unfinished one always has a
+// free slot, so the ring can never deadlock
+void PrimeStream::produce() {
+    std::vector<uint8_t> segment;
+    while (true) {
+        uint64_t k = nextSegment.fetch_add(1, std::memory_order_relaxed);
+        if (k >= numSegments) return;
+        Slot& slot = ring[k % ring.size()];
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            slotFree.wait(lock, [&] { return stopping || k < consumed + ring.size(); });
+            if (stopping) return;
+        }
+
+        uint64_t start = low + k * segmentSize;
+        uint64_t end = (high - start < segmentSize) ? high : start + segmentSize - 1;
+        slot.primes.clear();
+        engine.sieveWindow(start, end, segment, slot.primes);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            slot.segment = k;
+            slot.ready = true;
+        }
+        slotReady.notify_all();
+    }
+}
+
+bool PrimeStream::next(uint64_t& prime) {
+    while (true) {
+        if (current && cursor < current->primes.size()) {
+            prime = current->primes[cursor++];
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        if (current) {
+            // Done with this segment: hand its slot back to the workers
+            current->ready = false;
+            current = nullptr;
+            consumed++;
+            slotFree.notify_all();
+        }
+        if (consumed >= numSegments) return false;
+
+        Slot& slot = ring[consumed % ring.size()];
+        slotReady.wait(lock, [&] { return slot.ready && slot.segment == consumed; });
+        current = &slot;
+        cursor = 0;
+    }
+}
@@ -0,0 +1,61 @@
+// PrimeStream.h
+// Ordered, bounded-memory prime generator on top of PrimeEngine's sieve
+#ifndef PRIMESTREAM_H
+#define PRIMESTREAM_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "PrimeEngine.h"
+#include "CacheLine.h"
+
+// Yields the primes of [low, high] in ascending order while the engine's
+// workers are still sieving ahead. Workers claim segments in order and fill
+// the slots of a ring twice as long as the pool; a worker that gets a full
+// ring ahead of the reader waits for it (backpressure), so memory stays at
+// ring size x segment whatever the range. The engine must not run another
+// search while a stream is open
+class PrimeStream {
+private:
+    // Workers fill different slots at once, so each has its own cache lines
+    struct alignas(PADDED_ALIGNMENT) Slot {
+        std::vector<uint64_t> primes;
+        uint64_t segment = 0;
+        bool ready = false;
+    };
+
+    PrimeEngine& engine;
+    uint64_t low;
+    uint64_t high;
+    uint64_t segmentSize;
+    uint64_t numSegments;
+    std::vector<Slot> ring;
+    std::mutex mtx;
+    std::condition_variable slotFree;    // The reader released a slot
+    std::condition_variable slotReady;   // A worker filled a slot
+    uint64_t consumed = 0;               // Segments the reader has finished
+    CacheAligned<std::atomic<uint64_t>> nextSegment{0}; // Claimed without the lock
+    bool stopping = false;
+    Slot* current = nullptr;             // Slot being read, or null
+    size_t cursor = 0;
+
+    void produce();
+
+public:
+    // Numbers per segment unless the caller picks a size
+    static const uint64_t DEFAULT_SEGMENT_SIZE = 1 << 20;
+
+    PrimeStream(PrimeEngine& engine, uint64_t low, uint64_t high,
+                uint64_t segmentSize = DEFAULT_SEGMENT_SIZE);
+    ~PrimeStream();
+
+    PrimeStream(const PrimeStream&) = delete;
+    PrimeStream& operator=(const PrimeStream&) = delete;
+
+    // Stores the next prime and returns true, or returns false at the end
+    bool next(uint64_t& prime);
+};
+
+#endif
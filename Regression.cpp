@@ -0,0 +1,490 @@
+#include "Regression.h"
+#include "PrimeEngine.h"
+#include "PrimeStream.h"
+#include "Pipeline.h"
+#include "ResultFile.h"
+#include "Checkpoint.h"
+#include "SegmentCache.h"
+#include "Cluster.h"
+#include "MillerRabin.h"
+#include "Wheel.h"
+#include "SimpleJSON.h"
+#include "PrimeFinder.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+
+// Known prime counts: pi(2^16) = 6542, pi(10^6) = 78498, pi(2^24) = 1077871,
+// pi(2^26) = 3957809, pi(2^28) = 14630843, and 36249 primes in
+// [10^12, 10^12 + 10^6]. Every engine and result store is covered
+static const uint64_t TRILLION = 1000000000000ULL;
+static const RegressionCase CASES[] = {
+    {"range-trial-10^6",       "range",        "static",  "trial",        "vector",    1, 1000000,   78498,    false},
+    {"range-trial-2^24",       "range",        "dynamic", "trial",        "vector",    1, 1 << 24,   1077871,  false},
+    {"range-mr-2^24",          "range",        "static",  "miller_rabin", "vector",    1, 1 << 24,   1077871,  false},
+    {"range-mr-10^12",         "range",        "dynamic", "miller_rabin", "vector",    TRILLION, TRILLION + 1000000, 36249, false},
+    {"divisibility-10^6",      "divisibility", "static",  "trial",        "vector",    1, 1000000,   78498,    false},
+    {"divisibility-0-2^16",    "divisibility", "static",  "trial",        "vector",    0, 1 << 16,   6542,     false},
+    {"sieve-10^6",             "sieve",        "static",  "trial",        "vector",    1, 1000000,   78498,    false},
+    {"sieve-bitmap-2^26",      "sieve",        "dynamic", "trial",        "bitmap",    1, 1 << 26,   3957809,  false},
+    {"sieve-10^12",            "sieve",        "static",  "trial",        "vector",    TRILLION, TRILLION + 1000000, 36249, false},
+    {"sieve-2^28",             "sieve",        "static",  "trial",        "vector",    1, 1 << 28,   14630843, true},
+    {"sieve-aggregate-2^28",   "sieve",        "dynamic", "trial",        "aggregate", 1, 1 << 28,   14630843, true},
+};
+
+Regression::Regression(const RegressionOptions& opts) : options(opts) {}
+
+// Parse a positive integer of at most 9 digits
+static bool parseCount(const std::string& text, int& value) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoi(text);
+    return value > 0;
+}
+
+static void printUsage() {
+    std::cerr << "Usage: main --regress [options]\n"
+              << "  --baseline FILE     stored throughput (default regress_baseline.json)\n"
+              << "  --tolerance F       fail below (1 - F) x baseline (default 0.25)\n"
+              << "  --threads N         worker threads (default: the baseline's count, else\n"
+              << "                      every hardware thread)\n"
+              << "  --trials N          timed runs per case, the fastest counts (default 3)\n"
+              << "  --quick             skip the 2^28 cases\n"
+              << "  --update-baseline   save the measured throughput as the new baseline\n"
+              << "  --no-baseline       report throughput without judging it\n";
+}
+
+bool Regression::parseArgs(int argc, char* argv[], RegressionOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--regress") continue;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return false;
+        }
+        if (arg == "--quick") {
+            opts.quick = true;
+            continue;
+        }
+        if (arg == "--update-baseline") {
+            opts.updateBaseline = true;
+            continue;
+        }
+        if (arg == "--no-baseline") {
+            opts.noBaseline = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << arg << " needs a value\n";
+            printUsage();
+            return false;
+        }
+        std::string value = argv[++i];
+        bool ok = true;
+        char* end = nullptr;
+
+        if (arg == "--baseline") {
+            opts.baseline = value;
+        } else if (arg == "--tolerance") {
+            opts.tolerance = std::strtod(value.c_str(), &end);
+            ok = (end != value.c_str() && *end == '\0' && opts.tolerance >= 0 && opts.tolerance < 1);
+        } else if (arg == "--threads") {
+            ok = parseCount(value, opts.threads);
+        } else if (arg == "--trials") {
+            ok = parseCount(value, opts.trials);
+        } else {
+            std::cerr << "Error: unknown option " << arg << "\n";
+            printUsage();
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "Error: invalid value \"" << value << "\" for " << arg << "\n";
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads {"threads": N, "<case>": numbers per second, ...}; a missing file
+// is an empty baseline
+bool Regression::loadBaseline() {
+    std::ifstream file(options.baseline);
+    if (!file.is_open()) return true;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+
+    std::vector<SimpleJSON::Object> objects;
+    SimpleJSON::Error error;
+    if (!SimpleJSON::parse(content, objects, error) || objects.size() != 1) {
+        std::cerr << "[regress] Error: " << options.baseline << ":" << error.line << ":"
+                  << error.column << ": " << (error.message.empty() ? "expected one object" : error.message)
+                  << "\n";
+        return false;
+    }
+    for (const SimpleJSON::Field& field : objects[0].fields) {
+        double value = std::strtod(std::string(field.text).c_str(), nullptr);
+        if (field.key == "threads") {
+            baselineThreads = static_cast<int>(value);
+        } else {
+            baseline[std::string(field.key)] = value;
+        }
+    }
+    return true;
+}
+
+bool Regression::saveBaseline() const {
+    std::ofstream out(options.baseline, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << "{\n    \"threads\": " << options.threads;
+    out << std::fixed << std::setprecision(0);
+    for (const RegressionCase& c : CASES) {
+        auto it = measured.find(c.name);
+        if (it != measured.end()) out << ",\n    \"" << c.name << "\": " << it->second;
+    }
+    out << "\n}\n";
+    return static_cast<bool>(out);
+}
+
+void Regression::check(const std::string& name, bool ok, const std::string& detail) {
+    std::cout << "[regress] " << std::left << std::setw(24) << name << std::right
+              << (ok ? " ok" : " FAIL") << (detail.empty() ? "" : "  " + detail) << "\n";
+    if (!ok) failures++;
+}
+
+// Times one case, checks its count, and judges its best throughput
+void Regression::runCase(const RegressionCase& c) {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = c.scheme;
+    engineOptions.scheduler = c.scheduler;
+    engineOptions.primality_test = c.primality;
+    engineOptions.result_store = c.store;
+    PrimeEngine engine(engineOptions);
+
+    double best = 0;
+    uint64_t count = 0;
+    for (int i = 0; i < options.trials; i++) {
+        SearchResult result = engine.search(c.low, c.high);
+        count = result.primeCount;
+        if (i == 0 || result.seconds < best) best = result.seconds;
+        if (count != c.expected) break;
+    }
+    double rate = (c.high - c.low + 1) / std::max(best, 1e-9);
+    measured[c.name] = rate;
+
+    std::ostringstream detail;
+    detail << std::fixed << std::setprecision(1) << count << " primes, " << rate / 1e6
+           << " M numbers/s";
+    bool ok = (count == c.expected);
+    if (!ok) detail << ", expected " << c.expected << " primes";
+
+    auto it = baseline.find(c.name);
+    if (ok && it != baseline.end() && baselineThreads == options.threads && it->second > 0) {
+        double change = rate / it->second - 1;
+        detail << " (baseline " << it->second / 1e6 << ", " << std::showpos << change * 100
+               << std::noshowpos << "%)";
+        if (change < -options.tolerance) {
+            ok = false;
+            detail << ", slower than the " << options.tolerance * 100 << "% tolerance";
+        }
+    }
+    check(c.name, ok, detail.str());
+}
+
+// Writes 2^20 in both encodings and queries them back
+void Regression::checkResultFile(const std::string& dir) {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = "sieve";
+    PrimeEngine engine(engineOptions);
+    engine.search(1, 1 << 20);
+
+    for (ResultEncoding encoding : {RESULT_VARINT, RESULT_BITMAP}) {
+        std::string path = dir + "/primes-" + std::to_string(encoding) + ".bin";
+        {
+            ResultWriter writer(path, encoding, 1, 1 << 20);
+            engine.forEachPrime([&writer](uint64_t prime) { writer.add(prime); });
+            writer.finish();
+        }
+        ResultReader reader(path);
+        std::vector<uint64_t> small = reader.range(1, 10);
+        bool ok = reader.count() == 82025 && reader.nth(1) == 2 && reader.nth(82025) == 1048573 &&
+                  reader.nth(82026) == 0 && reader.rank(1000) == 168 &&
+                  reader.countRange(100, 200) == 21 && small == std::vector<uint64_t>{2, 3, 5, 7};
+        check(encoding == RESULT_VARINT ? "result-file-varint" : "result-file-bitmap", ok);
+    }
+}
+
+// Searches 2^20 in four checkpointed segments, then resumes from the files
+void Regression::checkCheckpoint(const std::string& dir) {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = "sieve";
+    PrimeEngine engine(engineOptions);
+    std::string path = dir + "/checkpoint.bin";
+    {
+        Checkpoint checkpoint(path, 1);
+        for (uint64_t low = 1; low <= (1 << 20); low += 1 << 18) {
+            engine.search(low, low + (1 << 18) - 1);
+            checkpoint.append(engine, low + (1 << 18) - 1);
+        }
+    }
+    Checkpoint resumed(path, 1);
+    bool ok = resumed.resumed() && resumed.nextNumber() == (1 << 20) + 1 &&
+              resumed.count() == 82025 && resumed.countUpTo(1000) == 168;
+    check("checkpoint-resume", ok);
+}
+
+// Caches two windows of 2^20 with a gap between them, then one bridging
+// both, and expects a single entry holding every prime left on disk
+void Regression::checkCache(const std::string& dir) {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = "sieve";
+    PrimeEngine engine(engineOptions);
+    std::string cacheDir = dir + "/cache";
+    auto cacheWindow = [&engine](SegmentCache& cache, uint64_t low, uint64_t high) {
+        SegmentCache::Update update(cache, low, high);
+        for (const SegmentCache::Piece& piece : cache.plan(low, high)) {
+            if (piece.path.empty()) {
+                engine.search(piece.low, piece.high);
+                engine.forEachPrime([&update](uint64_t prime) { update.add(prime); });
+            } else {
+                ResultReader(piece.path).forEachPrime(piece.low, piece.high,
+                    [&update](uint64_t prime) { update.add(prime); return true; });
+            }
+        }
+        update.commit();
+    };
+    {
+        SegmentCache cache(cacheDir);
+        cacheWindow(cache, 1, 1 << 18);
+        cacheWindow(cache, (1 << 19) + 1, 1 << 20);
+        cacheWindow(cache, 1000, (1 << 19) + 1000);
+    }
+    SegmentCache reopened(cacheDir);
+    std::vector<SegmentCache::Piece> pieces = reopened.plan(1, 1 << 20);
+    auto files = std::distance(std::filesystem::directory_iterator(cacheDir),
+                               std::filesystem::directory_iterator());
+    bool ok = reopened.entryCount() == 1 && files == 1 && pieces.size() == 1 &&
+              ResultReader(pieces[0].path).count() == 82025;
+    check("cache-merge", ok);
+}
+
+// Shards 2^24 over two loopback workers and queries the merged file
+void Regression::checkCluster(const std::string& dir) {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = "sieve";
+    PrimeEngine engineA(engineOptions), engineB(engineOptions);
+    ClusterWorker workerA(engineA, false), workerB(engineB, false);
+    std::vector<std::string> addresses = {
+        "127.0.0.1:" + std::to_string(workerA.listen("127.0.0.1", 0)),
+        "127.0.0.1:" + std::to_string(workerB.listen("127.0.0.1", 0)),
+    };
+    std::thread threadA([&workerA] { workerA.serve(); });
+    std::thread threadB([&workerB] { workerB.serve(); });
+
+    std::string path = dir + "/cluster.bin";
+    bool ok = false;
+    std::string detail;
+    try {
+        ClusterCoordinator coordinator(addresses, 1, 1 << 24, 1 << 21, path, RESULT_VARINT, 60);
+        ClusterResult result = coordinator.run();
+        ResultReader reader(path);
+        ok = result.primeCount == 1077871 && result.shards == 8 && reader.count() == 1077871 &&
+             reader.nth(1) == 2 && reader.nth(1077871) == 16777213 && reader.rank(1000) == 168;
+    } catch (const std::exception& e) {
+        detail = e.what();
+    }
+    workerA.stop();
+    workerB.stop();
+    threadA.join();
+    threadB.join();
+    check("cluster-loopback", ok, detail);
+}
+
+// The ordered stream and the pipeline must list what a plain search finds
+void Regression::checkStreams() {
+    EngineOptions engineOptions;
+    engineOptions.num_threads = options.threads;
+    engineOptions.division_scheme = "sieve";
+    PrimeEngine engine(engineOptions);
+    engine.search(1000000, 1 << 22);
+    std::vector<uint64_t> expected = engine.getPrimes();
+
+    std::vector<uint64_t> streamed;
+    {
+        PrimeStream stream(engine, 1000000, 1 << 22, 1 << 16);
+        uint64_t prime;
+        while (stream.next(prime)) streamed.push_back(prime);
+    }
+    check("stream-order", streamed == expected);
+
+    std::vector<uint64_t> piped;
+    PrimePipeline pipeline(engine, 1000000, 1 << 22, 2);
+    pipeline.run([&piped](const std::vector<uint64_t>& primes, const std::string&) {
+        piped.insert(piped.end(), primes.begin(), primes.end());
+    });
+    check("pipeline-order", piped == expected);
+}
+
+// A saved config must load back unchanged, whatever its strings hold
+void Regression::checkConfigRoundTrip(const std::string& dir) {
+    Config saved;
+    saved.num_threads = 3;
+    saved.min_number = 1000;
+    saved.max_number = 123456789;
+    saved.division_scheme = "sieve";
+    saved.output_file = "C:\\data\\primes.bin";
+    saved.output_format = "bitmap";
+    saved.checkpoint_file = "run \"7\".ckpt";
+    saved.checkpoint_interval = 1 << 20;
+    saved.cache_dir = "tab\there/new\nline/\x01";
+    saved.trace_file = "/tmp/trace-\xc3\xa9.json";
+    saved.cluster_workers = "host-a:7000,host-b:7001";
+    saved.shard_size = 1 << 24;
+    saved.shard_timeout = 45;
+    saved.test_numbers = {2, 91, 97};
+    std::string path = dir + "/config.json";
+
+    Config loaded;
+    ConfigError error;
+    bool ok = PrimeFinder::saveConfig(saved, path) && PrimeFinder::loadConfig(path, loaded, error);
+    ok = ok && loaded.num_threads == saved.num_threads && loaded.min_number == saved.min_number &&
+         loaded.max_number == saved.max_number && loaded.division_scheme == saved.division_scheme &&
+         loaded.output_file == saved.output_file && loaded.output_format == saved.output_format &&
+         loaded.checkpoint_file == saved.checkpoint_file &&
+         loaded.checkpoint_interval == saved.checkpoint_interval &&
+         loaded.cache_dir == saved.cache_dir && loaded.trace_file == saved.trace_file &&
+         loaded.cluster_workers == saved.cluster_workers && loaded.shard_size == saved.shard_size &&
+         loaded.shard_timeout == saved.shard_timeout &&
+         loaded.test_numbers == saved.test_numbers;
+    check("config-round-trip", ok, error.message);
+}
+
+// Unknown option values must be refused, not run as the defaults
+void Regression::checkEngineOptions() {
+    PrimeEngine engine;
+    int refused = 0;
+    for (int i = 0; i < 4; i++) {
+        EngineOptions bad;
+        if (i == 0) bad.division_scheme = "auto";
+        if (i == 1) bad.scheduler = "dynamc";
+        if (i == 2) bad.primality_test = "miller-rabin";
+        if (i == 3) bad.result_store = "bitset";
+        try {
+            engine.setOptions(bad);
+        } catch (const std::invalid_argument&) {
+            refused++;
+        }
+    }
+    engine.setOptions(EngineOptions());
+    check("engine-options", refused == 4 && engine.search(1, 100).primeCount == 25);
+}
+
+// Carmichael numbers and strong pseudoprimes to small bases must fail,
+// the largest primes below 2^62, 2^63 and 2^64 must pass
+void Regression::checkMillerRabin() {
+    static const uint64_t composites[] = {0, 1, 4, 561, 41041, 3215031751ULL,
+                                          3825123056546413051ULL, 998244359987710471ULL,
+                                          9223372036854775807ULL};
+    static const uint64_t primes[] = {2, 3, 1000000007, 2305843009213693951ULL,
+                                      4611686018427387847ULL, 9223372036854775783ULL,
+                                      18446744073709551557ULL};
+    bool ok = true;
+    for (uint64_t n : composites) ok = ok && !MillerRabin::isPrime(n);
+    for (uint64_t n : primes) ok = ok && MillerRabin::isPrime(n);
+
+    // And agree with trial division on every number below 2^16
+    EngineOptions trial;
+    PrimeEngine engine(trial);
+    for (uint64_t n = 0; n < (1 << 16) && ok; n++) ok = (MillerRabin::isPrime(n) == engine.isPrime(n));
+    check("miller-rabin", ok);
+}
+
+// 48 of every 210 numbers are coprime to 2, 3, 5 and 7
+void Regression::checkWheel() {
+    uint64_t count = 0;
+    uint64_t last = 0;
+    bool ordered = true;
+    for (uint64_t n : Wheel<210>::candidates(1000, 1000 + 210 * 100 - 1)) {
+        ordered = ordered && n > last && n % 2 && n % 3 && n % 5 && n % 7;
+        last = n;
+        count++;
+    }
+    check("wheel-210", ordered && count == 4800 && Wheel<210>::SPOKES == 48 && Wheel<30>::SPOKES == 8);
+}
+
+int Regression::run() {
+    if (!options.noBaseline && !loadBaseline()) return 1;
+    // Run at the baseline's thread count unless told otherwise, so the
+    // throughput gate applies on any machine
+    if (options.threads <= 0) {
+        options.threads = baselineThreads > 0
+            ? baselineThreads
+            : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    if (!baseline.empty() && baselineThreads != options.threads && !options.updateBaseline) {
+        std::cerr << "[regress] Error: " << options.baseline << " was measured with "
+                  << baselineThreads << " threads, not " << options.threads
+                  << "; pass --no-baseline to run without the throughput check\n";
+        return 1;
+    }
+    std::cout << "[regress] " << options.threads << " threads, best of " << options.trials << " trials";
+    if (options.noBaseline) {
+        std::cout << ", throughput not judged\n";
+    } else {
+        std::cout << ", tolerance " << options.tolerance * 100 << "%\n";
+    }
+
+    for (const RegressionCase& c : CASES) {
+        if (c.large && options.quick) continue;
+        runCase(c);
+    }
+
+    std::error_code error;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(error) /
+        ("prime-regress-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(dir, error);
+    try {
+        checkResultFile(dir.string());
+        checkCheckpoint(dir.string());
+        checkCache(dir.string());
+        checkCluster(dir.string());
+        checkStreams();
+        checkConfigRoundTrip(dir.string());
+    } catch (const std::exception& e) {
+        check("files-and-streams", false, e.what());
+    }
+    std::filesystem::remove_all(dir, error);
+    checkEngineOptions();
+    checkMillerRabin();
+    checkWheel();
+
+    if (options.updateBaseline) {
+        if (failures > 0) {
+            std::cerr << "[regress] Error: not updating " << options.baseline << " after failures\n";
+        } else if (!saveBaseline()) {
+            std::cerr << "[regress] Error: Could not write " << options.baseline << "\n";
+            return 1;
+        } else {
+            std::cout << "[regress] Saved the throughput to " << options.baseline << "\n";
+        }
+    }
+    std::cout << "[regress] " << (failures == 0 ? "All checks passed" : std::to_string(failures) + " failed")
+              << "\n";
+    return failures == 0 ? 0 : 1;
+}
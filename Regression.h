@@ -0,0 +1,77 @@
+// Regression.h
+// Correctness and performance regression suite (main --regress, make regress)
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+
+// Settings for one suite run, filled from the --regress command line
+struct RegressionOptions {
+    std::string baseline = "regress_baseline.json"; // Stored throughput per case
+    double tolerance = 0.25;     // Fail when a case is this fraction below its baseline
+    int threads = 0;             // 0 uses the baseline's count, else every hardware thread
+    int trials = 3;              // Timed runs per case; the fastest counts
+    bool quick = false;          // Skip the largest ranges
+    bool updateBaseline = false; // Write the measured throughput as the new baseline
+    bool noBaseline = false;     // Report throughput without judging it
+};
+
+// One search of the suite: an engine configuration over a fixed range, and
+// the number of primes it must find
+struct RegressionCase {
+    const char* name;            // Key of the case in the baseline file
+    const char* scheme;
+    const char* scheduler;
+    const char* primality;
+    const char* store;
+    uint64_t low;
+    uint64_t high;
+    uint64_t expected;           // Known pi(high) - pi(low - 1)
+    bool large;                  // Left out by --quick
+};
+
+// Runs every engine over fixed ranges and checks the prime counts against
+// known values of pi(N), then the result file, checkpoint, cache, cluster, stream,
+// pipeline, config file, option checks, Miller-Rabin and wheel code against known answers. Searches
+// are timed too: a case whose throughput falls more than tolerance below
+// the stored baseline fails the run. The suite runs at the baseline's
+// thread count, and another explicit count is refused unless the baseline
+// is being replaced or left out; cases the baseline lacks are reported and
+// not judged
+class Regression {
+private:
+    RegressionOptions options;
+    std::map<std::string, double> baseline;  // Numbers per second by case name
+    int baselineThreads = 0;
+    std::map<std::string, double> measured;
+    int failures = 0;
+
+    bool loadBaseline();
+    bool saveBaseline() const;
+    void runCase(const RegressionCase& c);
+    void check(const std::string& name, bool ok, const std::string& detail = std::string());
+    void checkResultFile(const std::string& dir);
+    void checkCheckpoint(const std::string& dir);
+    void checkCache(const std::string& dir);
+    void checkCluster(const std::string& dir);
+    void checkStreams();
+    void checkEngineOptions();
+    void checkConfigRoundTrip(const std::string& dir);
+    void checkMillerRabin();
+    void checkWheel();
+
+public:
+    explicit Regression(const RegressionOptions& opts);
+
+    // Parses "--regress [--baseline FILE] [--tolerance F] ..." into options
+    // Returns false and prints usage on bad arguments
+    static bool parseArgs(int argc, char* argv[], RegressionOptions& opts);
+
+    // Runs the whole suite; returns a process exit code, 1 on any failure
+    int run();
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include "ResultFile.h"
+#include "PrimeFinder.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char RESULT_MAGIC[8] = {'P', 'R', 'I', 'M', 'E', 'R', 'E', 'S'};
+static const size_t FLUSH_BYTES = 1 << 20;
+
+// Odd numbers the bitmap encoding covers for the window [low, high]
+static uint64_t bitmapBits(uint64_t low, uint64_t high) {
+    uint64_t firstOdd = low | 1;
+    return (low > high || firstOdd > high) ? 0 : (high - firstOdd) / 2 + 1;
+}
+
+ResultWriter::ResultWriter(const std::string& path, ResultEncoding encoding,
+                           uint64_t low, uint64_t high)
+    : out(path, std::ios::binary | std::ios::trunc) {
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open " + path + " for writing");
+    }
+    // The magic stays zero until finish(), so a cut-short file is rejected
+    std::memset(&header, 0, sizeof(header));
+    header.version = RESULT_FILE_VERSION;
+    header.encoding = encoding;
+    header.low = low;
+    header.high = high;
+    header.dataOffset = sizeof(ResultFileHeader);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    firstOdd = low | 1;
+    numWords = (bitmapBits(low, high) + 63) / 64;
+    buffer.reserve(FLUSH_BYTES + 16);
+}
+
+ResultWriter::~ResultWriter() {
+    if (!finished) out.close();
+}
+
+bool ResultWriter::parseEncoding(const std::string& name, ResultEncoding& encoding) {
+    if (name == "varint") {
+        encoding = RESULT_VARINT;
+    } else if (name == "bitmap") {
+        encoding = RESULT_BITMAP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// LEB128: 7 bits per byte, high bit set on every byte but the last
+size_t ResultWriter::appendVarint(uint64_t value, std::vector<uint8_t>& out) {
+    size_t bytes = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out.push_back(value ? (byte | 0x80) : byte);
+        bytes++;
+    } while (value);
+    return bytes;
+}
+
+void ResultWriter::flushBuffer() {
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    buffer.clear();
+}
+
+// Close the current bitmap word, with an index entry at every block start
+void ResultWriter::emitWord() {
+    if (wordIndex % INDEX_STRIDE == 0) index.push_back({oddRank, wordIndex});
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&bits);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(bits));
+    header.dataBytes += sizeof(bits);
+    oddRank += __builtin_popcountll(bits);
+    bits = 0;
+    wordIndex++;
+    if (buffer.size() >= FLUSH_BYTES) flushBuffer();
+}
+
+void ResultWriter::add(uint64_t prime) {
+    header.count++;
+
+    if (header.encoding == RESULT_BITMAP) {
+        if (prime == 2) {
+            header.flags |= 1;
+            return;
+        }
+        uint64_t bit = (prime - firstOdd) / 2;
+        while (wordIndex < bit / 64) emitWord();
+        bits |= 1ULL << (bit % 64);
+        return;
+    }
+
+    header.dataBytes += appendVarint(prime - previous, buffer);
+    previous = prime;
+
+    if ((header.count - 1) % INDEX_STRIDE == 0) index.push_back({prime, header.dataBytes});
+    if (buffer.size() >= FLUSH_BYTES) flushBuffer();
+}
+
+uint64_t ResultWriter::finish() {
+    if (header.encoding == RESULT_BITMAP) {
+        while (wordIndex < numWords) emitWord();
+    }
+    // Pad the data so the index that follows is 8-byte aligned
+    while (header.dataBytes % 8 != 0) {
+        buffer.push_back(0);
+        header.dataBytes++;
+    }
+    flushBuffer();
+
+    header.indexOffset = header.dataOffset + header.dataBytes;
+    header.indexEntries = index.size();
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(ResultIndexEntry));
+
+    std::memcpy(header.magic, RESULT_MAGIC, sizeof(header.magic));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    finished = true;
+    if (!out) throw std::runtime_error("Could not write the result file");
+    return header.indexOffset + header.indexEntries * sizeof(ResultIndexEntry);
+}
+
+ResultReader::ResultReader(const std::string& path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open " + path);
+    file = handle;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(handle, &fileSize)) size = static_cast<size_t>(fileSize.QuadPart);
+    if (size >= sizeof(ResultFileHeader)) {
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) base = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open " + path);
+    struct stat info;
+    if (fstat(fd, &info) == 0) size = static_cast<size_t>(info.st_size);
+    if (size >= sizeof(ResultFileHeader)) {
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) base = static_cast<const uint8_t*>(view);
+    }
+#endif
+    if (base == nullptr) {
+        close();
+        throw std::runtime_error(path + " is not a result file");
+    }
+
+    header = reinterpret_cast<const ResultFileHeader*>(base);
+    uint64_t expectedEntries = header->encoding == RESULT_BITMAP
+        ? (header->dataBytes / 8 + INDEX_STRIDE - 1) / INDEX_STRIDE
+        : (header->count + INDEX_STRIDE - 1) / INDEX_STRIDE;
+    bool valid = std::memcmp(header->magic, RESULT_MAGIC, sizeof(RESULT_MAGIC)) == 0 &&
+                 header->version == RESULT_FILE_VERSION &&
+                 header->encoding <= RESULT_BITMAP &&
+                 header->dataOffset % 8 == 0 && header->indexOffset % 8 == 0 &&
+                 header->dataOffset + header->dataBytes <= size &&
+                 header->indexOffset >= header->dataOffset + header->dataBytes &&
+                 header->indexEntries == expectedEntries &&
+                 header->indexOffset + header->indexEntries * sizeof(ResultIndexEntry) <= size;
+    if (valid && header->encoding == RESULT_BITMAP) {
+        valid = header->dataBytes == (bitmapBits(header->low, header->high) + 63) / 64 * 8;
+    }
+    if (!valid) {
+        close();
+        throw std::runtime_error(path + " is not a valid result file");
+    }
+    data = base + header->dataOffset;
+    index = reinterpret_cast<const ResultIndexEntry*>(base + header->indexOffset);
+}
+
+ResultReader::~ResultReader() {
+    close();
+}
+
+void ResultReader::close() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (base) munmap(const_cast<uint8_t*>(base), size);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    base = nullptr;
+}
+
+// Decode the next varint prime; false once every prime has been read
+bool ResultReader::next(Cursor& cursor) const {
+    if (cursor.rank >= header->count) return false;
+    uint64_t delta = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (cursor.offset >= header->dataBytes || shift > 63) {
+            throw std::runtime_error("Result file data is corrupt");
+        }
+        uint8_t byte = data[cursor.offset++];
+        delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    cursor.prime += delta;
+    cursor.rank++;
+    return true;
+}
+
+// Varint cursor at the last prime below n, starting from the nearest
+// index entry so at most INDEX_STRIDE primes are decoded
+ResultReader::Cursor ResultReader::cursorBefore(uint64_t n) const {
+    const ResultIndexEntry* end = index + header->indexEntries;
+    const ResultIndexEntry* entry = std::partition_point(index, end,
+        [n](const ResultIndexEntry& e) { return e.value < n; });
+
+    Cursor cursor = {0, 0, 0};
+    if (entry != index) {
+        entry--;
+        cursor = {entry->value, static_cast<uint64_t>(entry - index) * INDEX_STRIDE + 1,
+                  entry->position};
+    }
+    Cursor ahead = cursor;
+    while (next(ahead) && ahead.prime < n) cursor = ahead;
+    return cursor;
+}
+
+// Odd primes stored in bits below bit, from the block index plus popcounts
+uint64_t ResultReader::oddRankBefore(uint64_t bit) const {
+    uint64_t twoCount = header->flags & 1;
+    if (bit >= bitmapBits(header->low, header->high)) return header->count - twoCount;
+
+    uint64_t word = bit / 64;
+    uint64_t block = word / INDEX_STRIDE;
+    uint64_t rank = index[block].value;
+    for (uint64_t i = block * INDEX_STRIDE; i < word; i++) {
+        rank += __builtin_popcountll(words()[i]);
+    }
+    if (bit % 64) rank += __builtin_popcountll(words()[word] & ((1ULL << (bit % 64)) - 1));
+    return rank;
+}
+
+uint64_t ResultReader::nth(uint64_t k) const {
+    if (k == 0 || k > header->count) return 0;
+
+    if (header->encoding == RESULT_VARINT) {
+        const ResultIndexEntry& entry = index[(k - 1) / INDEX_STRIDE];
+        Cursor cursor = {entry.value, (k - 1) / INDEX_STRIDE * INDEX_STRIDE + 1, entry.position};
+        while (cursor.rank < k) next(cursor);
+        return cursor.prime;
+    }
+
+    if (header->flags & 1) {
+        if (k == 1) return 2;
+        k--;
+    }
+    // Last block that starts before the k-th odd prime, then popcount forward
+    const ResultIndexEntry* entry = std::partition_point(index, index + header->indexEntries,
+        [k](const ResultIndexEntry& e) { return e.value < k; }) - 1;
+    k -= entry->value;
+    uint64_t numWords = header->dataBytes / 8;
+    for (uint64_t i = entry->position; i < numWords; i++) {
+        uint64_t bits = words()[i];
+        uint64_t inWord = __builtin_popcountll(bits);
+        if (k > inWord) {
+            k -= inWord;
+            continue;
+        }
+        while (--k > 0) bits &= bits - 1;
+        return (header->low | 1) + 2 * (i * 64 + __builtin_ctzll(bits));
+    }
+    return 0;
+}
+
+uint64_t ResultReader::rank(uint64_t n) const {
+    if (n < header->low || header->count == 0) return 0;
+    n = std::min(n, header->high);
+
+    if (header->encoding == RESULT_VARINT) return cursorBefore(n + 1).rank;
+
+    uint64_t rank = (header->flags & 1) && n >= 2 ? 1 : 0;
+    uint64_t firstOdd = header->low | 1;
+    if (n < firstOdd) return rank;
+    return rank + oddRankBefore((n - firstOdd) / 2 + 1);
+}
+
+uint64_t ResultReader::countRange(uint64_t a, uint64_t b) const {
+    if (a > b) return 0;
+    return rank(b) - (a == 0 ? 0 : rank(a - 1));
+}
+
+std::vector<uint64_t> ResultReader::range(uint64_t a, uint64_t b) const {
+    std::vector<uint64_t> result;
+    forEachPrime(a, b, [&result](uint64_t prime) { result.push_back(prime); return true; });
+    return result;
+}
+
+static void printQueryUsage() {
+    std::cerr << "Usage: main --query FILE info\n"
+              << "       main --query FILE count [A B]\n"
+              << "       main --query FILE nth K\n"
+              << "       main --query FILE range A B\n"
+              << "Numbers accept \"2^X\" or plain integers.\n";
+}
+
+// FEATURE: Query a binary result file without searching again
+int ResultReader::query(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);   // "--query" FILE COMMAND ...
+    if (args.size() < 3) {
+        printQueryUsage();
+        return 1;
+    }
+    const std::string& command = args[2];
+    std::vector<uint64_t> numbers;
+    for (size_t i = 3; i < args.size(); i++) {
+        uint64_t value;
+        if (!PrimeFinder::parseNumber(args[i], value)) {
+            std::cerr << "Error: \"" << args[i] << "\" is not a valid number\n";
+            return 1;
+        }
+        numbers.push_back(value);
+    }
+
+    bool known = (command == "info" && numbers.empty()) ||
+                 (command == "count" && (numbers.empty() || numbers.size() == 2)) ||
+                 (command == "nth" && numbers.size() == 1) ||
+                 (command == "range" && numbers.size() == 2);
+    if (!known) {
+        printQueryUsage();
+        return 1;
+    }
+    if (command == "nth" && numbers[0] == 0) {
+        std::cerr << "Error: k must be at least 1\n";
+        return 1;
+    }
+
+    try {
+        ResultReader reader(args[1]);
+        if (command == "info") {
+            std::cout << "File: " << args[1] << "\n";
+            std::cout << "  - Encoding: " << (reader.encoding() == RESULT_BITMAP ? "bitmap" : "varint") << "\n";
+            std::cout << "  - Range: " << reader.low() << " to " << reader.high() << "\n";
+            std::cout << "  - Primes: " << reader.count() << "\n";
+            std::cout << "  - File size: " << reader.fileBytes() << " bytes\n";
+        } else if (command == "count") {
+            std::cout << (numbers.empty() ? reader.count() : reader.countRange(numbers[0], numbers[1])) << "\n";
+        } else if (command == "nth") {
+            uint64_t prime = reader.nth(numbers[0]);
+            if (prime == 0) {
+                std::cerr << "Error: the file holds only " << reader.count() << " primes\n";
+                return 1;
+            }
+            std::cout << prime << "\n";
+        } else {
+            for (uint64_t prime : reader.range(numbers[0], numbers[1])) {
+                std::cout << prime << "\n";
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
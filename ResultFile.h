@@ -0,0 +1,182 @@
+// ResultFile.h
+// Compact binary result files: a streaming writer, and a memory-mapped
+// reader that answers count, nth-prime and range queries in place
+#ifndef RESULTFILE_H
+#define RESULTFILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// On-disk layout, in native byte order (little-endian on every supported
+// target): the header, then the data, then an index of fixed-stride
+// checkpoints so queries never have to decode the whole file
+//
+//   varint encoding: each prime as the LEB128 varint of its distance from
+//     the previous one (the first from 0). Index entry i holds prime number
+//     i * INDEX_STRIDE + 1 and the data offset just past its varint
+//   bitmap encoding: the odd-only bitmap of PrimeBitmap, one bit per odd
+//     number from (low | 1), as 64-bit words; 2 is flag bit 0. Index entry
+//     i holds the number of odd primes before word i * INDEX_STRIDE
+enum ResultEncoding : uint32_t {
+    RESULT_VARINT = 0,
+    RESULT_BITMAP = 1
+};
+
+struct ResultFileHeader {
+    char magic[8];            // "PRIMERES"
+    uint32_t version;
+    uint32_t encoding;        // ResultEncoding
+    uint64_t low;             // Searched window [low, high]
+    uint64_t high;
+    uint64_t count;           // Primes in the file
+    uint64_t flags;           // Bitmap encoding: bit 0 set when 2 is stored
+    uint64_t dataOffset;
+    uint64_t dataBytes;
+    uint64_t indexOffset;
+    uint64_t indexEntries;
+};
+
+struct ResultIndexEntry {
+    uint64_t value;           // Prime (varint) or odd primes before the block (bitmap)
+    uint64_t position;        // Data offset after that prime (varint) or word index (bitmap)
+};
+
+static const uint32_t RESULT_FILE_VERSION = 1;
+static const uint64_t INDEX_STRIDE = 1024;   // Primes (varint) or words (bitmap) per entry
+
+// Writes primes, given in ascending order, straight to disk
+// Throws std::runtime_error if the file cannot be written
+class ResultWriter {
+private:
+    std::ofstream out;
+    ResultFileHeader header;
+    std::vector<ResultIndexEntry> index;
+    std::vector<uint8_t> buffer;      // Pending data, flushed in large writes
+    uint64_t previous = 0;            // Varint: last prime written
+    uint64_t firstOdd = 0;            // Bitmap: number represented by bit 0
+    uint64_t numWords = 0;
+    uint64_t wordIndex = 0;           // Bitmap: word being filled
+    uint64_t bits = 0;
+    uint64_t oddRank = 0;             // Bitmap: odd primes in finished words
+    bool finished = false;
+
+    void emitWord();
+    void flushBuffer();
+
+public:
+    ResultWriter(const std::string& path, ResultEncoding encoding, uint64_t low, uint64_t high);
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    // prime must lie in [low, high] and exceed every prime added before it
+    void add(uint64_t prime);
+
+    // Writes the index and the final header; returns the file size in bytes
+    uint64_t finish();
+
+    static bool parseEncoding(const std::string& name, ResultEncoding& encoding);
+
+    // Appends value as a LEB128 varint; returns the number of bytes added
+    static size_t appendVarint(uint64_t value, std::vector<uint8_t>& out);
+};
+
+// Read-only view of a result file, mapped into memory rather than loaded
+// Throws std::runtime_error if the file is missing or malformed
+class ResultReader {
+private:
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    const ResultFileHeader* header = nullptr;
+    const uint8_t* data = nullptr;
+    const ResultIndexEntry* index = nullptr;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    // Varint decoding position: the last prime read and where the next starts
+    struct Cursor {
+        uint64_t prime;
+        uint64_t rank;        // 1-based rank of prime, 0 before the first
+        uint64_t offset;
+    };
+    bool next(Cursor& cursor) const;
+    Cursor cursorBefore(uint64_t n) const;
+    const uint64_t* words() const { return reinterpret_cast<const uint64_t*>(data); }
+    uint64_t oddRankBefore(uint64_t bit) const;
+    void close();
+
+public:
+    explicit ResultReader(const std::string& path);
+    ~ResultReader();
+
+    ResultReader(const ResultReader&) = delete;
+    ResultReader& operator=(const ResultReader&) = delete;
+
+    uint64_t low() const { return header->low; }
+    uint64_t high() const { return header->high; }
+    uint64_t count() const { return header->count; }
+    ResultEncoding encoding() const { return static_cast<ResultEncoding>(header->encoding); }
+    size_t fileBytes() const { return size; }
+
+    // The k-th prime in the file, counting from 1; 0 if there are fewer than k
+    uint64_t nth(uint64_t k) const;
+
+    // Number of primes <= n in the file
+    uint64_t rank(uint64_t n) const;
+
+    // Primes in [a, b], and the number of them
+    uint64_t countRange(uint64_t a, uint64_t b) const;
+    std::vector<uint64_t> range(uint64_t a, uint64_t b) const;
+
+    // Calls fn for each prime in [a, b] in ascending order, until fn returns
+    // false; decodes in place, so nothing is collected
+    template <typename Fn>
+    void forEachPrime(uint64_t a, uint64_t b, Fn fn) const;
+
+    // main --query FILE info | count | nth K | range A B
+    static int query(int argc, char* argv[]);
+};
+
+template <typename Fn>
+void ResultReader::forEachPrime(uint64_t a, uint64_t b, Fn fn) const {
+    a = std::max(a, header->low);
+    b = std::min(b, header->high);
+    if (a > b || header->count == 0) return;
+
+    if (header->encoding == RESULT_VARINT) {
+        Cursor cursor = cursorBefore(a);
+        while (next(cursor) && cursor.prime <= b) {
+            if (!fn(cursor.prime)) return;
+        }
+        return;
+    }
+
+    if ((header->flags & 1) && a <= 2 && b >= 2 && !fn(uint64_t(2))) return;
+    uint64_t firstOdd = header->low | 1;
+    uint64_t first = std::max(a, firstOdd) | 1;
+    uint64_t last = (b % 2 == 0) ? b - 1 : b;
+    if (first > last || last < firstOdd) return;
+
+    uint64_t firstBit = (first - firstOdd) / 2;
+    uint64_t lastBit = (last - firstOdd) / 2;
+    for (uint64_t w = firstBit / 64; w <= lastBit / 64; w++) {
+        uint64_t bits = words()[w];
+        if (w == firstBit / 64) bits &= ~0ULL << (firstBit % 64);
+        if (w == lastBit / 64 && lastBit % 64 != 63) bits &= (1ULL << (lastBit % 64 + 1)) - 1;
+        while (bits) {
+            if (!fn(firstOdd + 2 * (w * 64 + __builtin_ctzll(bits)))) return;
+            bits &= bits - 1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "SegmentCache.h"
+#include "ResultFile.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <filesystem>
+
+// Loads the index of the entries already in directory, creating it if needed
+SegmentCache::SegmentCache(const std::string& directory) : dir(directory) {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    if (!std::filesystem::is_directory(dir, error)) {
+        throw std::runtime_error("Could not create cache directory " + dir);
+    }
+
+    for (const auto& file : std::filesystem::directory_iterator(dir, error)) {
+        std::string name = file.path().filename().string();
+        unsigned long long low = 0, high = 0;
+        if (std::sscanf(name.c_str(), "primes-%llu-%llu.bin", &low, &high) != 2 ||
+            name != "primes-" + std::to_string(low) + "-" + std::to_string(high) + ".bin") {
+            continue;   // Not an entry, e.g. a temporary file
+        }
+        try {
+            ResultReader reader(file.path().string());
+            if (reader.low() != low || reader.high() != high ||
+                reader.encoding() != RESULT_VARINT) {
+                continue;
+            }
+        } catch (const std::runtime_error&) {
+            continue;   // Not a result file, or a damaged one
+        }
+        entries.push_back({low, high, file.path().string()});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.low != b.low ? a.low < b.low : a.high > b.high;
+    });
+
+    // Two runs sharing the directory may have stored the same gap, and a run
+    // killed while merging leaves the absorbed entries next to the merged
+    // one; keep the first, widest entry of each overlap
+    std::vector<Entry> disjoint;
+    for (const Entry& entry : entries) {
+        if (!disjoint.empty() && entry.low <= disjoint.back().high) continue;
+        disjoint.push_back(entry);
+    }
+    entries.swap(disjoint);
+}
+
+std::string SegmentCache::entryPath(uint64_t low, uint64_t high) const {
+    return (std::filesystem::path(dir) /
+            ("primes-" + std::to_string(low) + "-" + std::to_string(high) + ".bin")).string();
+}
+
+std::vector<SegmentCache::Piece> SegmentCache::plan(uint64_t low, uint64_t high) const {
+    std::vector<Piece> pieces;
+    uint64_t next = low;   // First number not yet covered
+    bool done = false;
+    auto it = std::upper_bound(entries.begin(), entries.end(), low,
+                               [](uint64_t n, const Entry& e) { return n < e.low; });
+    if (it != entries.begin() && std::prev(it)->high >= low) --it;
+
+    for (; it != entries.end() && it->low <= high && !done; ++it) {
+        if (it->low > next) pieces.push_back({next, it->low - 1, std::string()});
+        uint64_t sliceHigh = std::min(it->high, high);
+        pieces.push_back({std::max(it->low, next), sliceHigh, it->path});
+        done = (sliceHigh == high);
+        next = sliceHigh + 1;
+    }
+    if (!done) pieces.push_back({next, high, std::string()});
+    return pieces;
+}
+
+// Absorbs every entry that overlaps [low, high] or ends or starts right
+// next to it, and opens the merged entry with the part of the first one
+// that lies below the window
+SegmentCache::Update::Update(SegmentCache& owner, uint64_t windowLow, uint64_t windowHigh)
+    : cache(owner), low(windowLow), high(windowHigh) {
+    std::vector<Entry>& entries = cache.entries;
+    first = std::lower_bound(entries.begin(), entries.end(), windowLow,
+                             [](const Entry& e, uint64_t n) { return e.high + 1 < n; }) -
+            entries.begin();
+    last = first;
+    while (last < entries.size() && entries[last].low <= windowHigh + 1) last++;
+
+    mergedLow = windowLow;
+    mergedHigh = windowHigh;
+    if (last > first) {
+        mergedLow = std::min(mergedLow, entries[first].low);
+        mergedHigh = std::max(mergedHigh, entries[last - 1].high);
+    }
+    path = cache.entryPath(mergedLow, mergedHigh);
+    tempPath = path + ".tmp";
+    writer.reset(new ResultWriter(tempPath, RESULT_VARINT, mergedLow, mergedHigh));
+
+    if (last > first && entries[first].low < windowLow) {
+        ResultReader left(entries[first].path);
+        left.forEachPrime(left.low(), windowLow - 1,
+                          [this](uint64_t prime) { writer->add(prime); return true; });
+    }
+}
+
+SegmentCache::Update::~Update() {
+    if (committed) return;
+    writer.reset();
+    std::remove(tempPath.c_str());
+}
+
+// Copies the part of the last absorbed entry above the window, then
+// renames the merged entry into place before the absorbed ones go
+void SegmentCache::Update::commit() {
+    std::vector<Entry>& entries = cache.entries;
+    if (last > first && entries[last - 1].high > high) {
+        ResultReader right(entries[last - 1].path);
+        right.forEachPrime(high + 1, right.high(),
+                           [this](uint64_t prime) { writer->add(prime); return true; });
+    }
+    writer->finish();
+    writer.reset();
+#ifdef _WIN32
+    std::remove(path.c_str());  // rename does not replace on Windows
+#endif
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not store cache entry " + path);
+    }
+    committed = true;
+
+    for (size_t i = first; i < last; i++) {
+        if (entries[i].path != path) std::remove(entries[i].path.c_str());
+    }
+    entries.erase(entries.begin() + first, entries.begin() + last);
+    entries.insert(entries.begin() + first, Entry{mergedLow, mergedHigh, path});
+}
@@ -0,0 +1,82 @@
+// SegmentCache.h
+// Persistent result cache: ranges searched by earlier runs are kept on disk
+// and read back instead of being searched again
+#ifndef SEGMENTCACHE_H
+#define SEGMENTCACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "ResultFile.h"
+
+// Every entry is a varint result file "primes-<low>-<high>.bin" in the
+// cache directory holding all primes of [low, high]. Entries never
+// overlap or touch: a search reads the entries that intersect its window
+// and only searches the gaps between them, then rewrites the window and
+// every entry it meets or adjoins as one entry, so the index stays as small
+// as the covered ranges allow. Entries are written to a temporary file and
+// renamed into place, so a run killed mid-write leaves no partial entry
+// behind; files that do not parse as entries are ignored
+// Throws std::runtime_error if the directory or an entry cannot be written
+class SegmentCache {
+public:
+    // Part of a window: a cached entry's slice, or a gap (empty path)
+    struct Piece {
+        uint64_t low;
+        uint64_t high;
+        std::string path;
+    };
+
+    explicit SegmentCache(const std::string& directory);
+
+    // Splits [low, high] into cached slices and gaps, in ascending order
+    std::vector<Piece> plan(uint64_t low, uint64_t high) const;
+
+    // Rebuilds [low, high] and the entries it overlaps or adjoins as one
+    // entry. The caller adds every prime of [low, high] in ascending order,
+    // from the cache or a search; the neighbours' primes outside the window
+    // are copied over. Nothing changes unless commit() is called
+    class Update {
+    public:
+        Update(SegmentCache& cache, uint64_t low, uint64_t high);
+        ~Update();
+
+        Update(const Update&) = delete;
+        Update& operator=(const Update&) = delete;
+
+        void add(uint64_t prime) { writer->add(prime); }
+
+        // Replaces the absorbed entries with the merged one
+        void commit();
+
+    private:
+        SegmentCache& cache;
+        uint64_t low;                 // The caller's window
+        uint64_t high;
+        uint64_t mergedLow;           // The entry being written
+        uint64_t mergedHigh;
+        size_t first;                 // Absorbed entries are [first, last)
+        size_t last;
+        std::string path;
+        std::string tempPath;
+        std::unique_ptr<ResultWriter> writer;
+        bool committed = false;
+    };
+
+    size_t entryCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t low;
+        uint64_t high;
+        std::string path;
+    };
+
+    std::string dir;
+    std::vector<Entry> entries;   // Sorted by low, disjoint and not adjacent
+
+    std::string entryPath(uint64_t low, uint64_t high) const;
+};
+
+#endif
@@ -2,11 +2,143 @@
 #define SIMPLEJSON_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cctype>
 
-// Simple JSON parser for our config file
-// Handles basic JSON structure with string and integer values
+// Simple JSON parser for our config files
+// One pass over the text lists each object's key/value pairs as views into
+// it, so reading a key copies nothing, and nothing throws: malformed input
+// comes back as an Error with its line and column. A file holds one object,
+// or an array of objects (one per job). Values are strings, numbers, true,
+// false or null; nested objects and arrays are rejected
 class SimpleJSON {
 public:
+    // Why parsing failed, and where; line and column count from 1
+    struct Error {
+        size_t line = 0;      // 0 if the error has no position
+        size_t column = 0;
+        std::string message;
+    };
+
+    // One "key": value pair. text views the value in the content: for a
+    // string its characters between the quotes, escapes still encoded, and
+    // otherwise the token itself
+    struct Field {
+        std::string_view key;
+        std::string_view text;
+        bool quoted = false;
+        size_t offset = 0;    // Of the value in the content, for errors
+    };
+
+    struct Object {
+        std::vector<Field> fields;
+
+        // The field named key, or null
+        const Field* find(std::string_view key) const {
+            for (const Field& field : fields) {
+                if (field.key == key) return &field;
+            }
+            return nullptr;
+        }
+    };
+
+    // Appends the objects of content to objects. Returns false and sets
+    // error on malformed input, a nested value or a repeated key
+    static bool parse(std::string_view content, std::vector<Object>& objects, Error& error) {
+        Parser parser{content, 0, objects, error};
+        return parser.document();
+    }
+
+    // An Error pointing at offset in content
+    static Error errorAt(std::string_view content, size_t offset, const std::string& message) {
+        Error error;
+        error.line = 1;
+        error.column = 1;
+        for (size_t i = 0; i < offset && i < content.size(); i++) {
+            if (content[i] == '\n') {
+                error.line++;
+                error.column = 1;
+            } else {
+                error.column++;
+            }
+        }
+        error.message = message;
+        return error;
+    }
+
+    // A string value's characters with its escapes decoded
+    static std::string decode(std::string_view text) {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] != '\\' || i + 1 >= text.size()) {
+                out.push_back(text[i]);
+                continue;
+            }
+            char c = text[++i];
+            switch (c) {
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    // parse() checked the four hex digits; encode as UTF-8
+                    unsigned code = 0;
+                    for (size_t k = 1; k <= 4 && i + k < text.size(); k++) {
+                        char h = text[i + k];
+                        code = code * 16 + static_cast<unsigned>(
+                            h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+                    }
+                    i += 4;
+                    if (code < 0x80) {
+                        out.push_back(static_cast<char>(code));
+                    } else if (code < 0x800) {
+                        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                    } else {
+                        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                    }
+                    break;
+                }
+                default: out.push_back(c); break;   // \" \\ and \/
+            }
+        }
+        return out;
+    }
+
+    // The inverse of decode: text with quotes, backslashes and control characters
+    // escaped, ready to be written between quotes
+    static std::string encode(std::string_view text) {
+        static const char HEX[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(text.size());
+        for (char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out += "\\u00";
+                        out.push_back(HEX[(c >> 4) & 0xF]);
+                        out.push_back(HEX[c & 0xF]);
+                    } else {
+                        out.push_back(c);
+                    }
+            }
+        }
+        return out;
+    }
+
     // Trim whitespace and quotes from a string
     static std::string trim(const std::string& str) {
         size_t first = str.find_first_not_of(" \t\n\r\"");
@@ -14,28 +146,181 @@ public:
         size_t last = str.find_last_not_of(" \t\n\r\",");
         return str.substr(first, (last - first + 1));
     }
-    
-    // Extract integer value for a given key from JSON content
-    static int getInt(const std::string& content, const std::string& key) {
-        size_t pos = content.find("\"" + key + "\"");
-        if (pos == std::string::npos) return 0;
-        
-        pos = content.find(":", pos);
-        size_t endPos = content.find_first_of(",}", pos);
-        std::string value = trim(content.substr(pos + 1, endPos - pos - 1));
-        return std::stoi(value);
-    }
-    
-    // Extract string value for a given key from JSON content
-    static std::string getString(const std::string& content, const std::string& key) {
-        size_t pos = content.find("\"" + key + "\"");
-        if (pos == std::string::npos) return "";
-        
-        pos = content.find(":", pos);
-        size_t startQuote = content.find("\"", pos);
-        size_t endQuote = content.find("\"", startQuote + 1);
-        return content.substr(startQuote + 1, endQuote - startQuote - 1);
+
+    // The value of key in a single-object document, quoted or not, with
+    // quotes stripped; "" if the key is missing or the document malformed
+    // Lets callers accept both "max_number": 65536 and "max_number": "2^16"
+    static std::string getValue(const std::string& content, const std::string& key) {
+        std::vector<Object> objects;
+        Error error;
+        if (!parse(content, objects, error) || objects.size() != 1) return "";
+        const Field* field = objects[0].find(key);
+        if (!field) return "";
+        return field->quoted ? decode(field->text) : std::string(field->text);
     }
+
+private:
+    struct Parser {
+        std::string_view text;
+        size_t pos;
+        std::vector<Object>& objects;
+        Error& error;
+
+        bool fail(const std::string& message) {
+            error = errorAt(text, pos, message);
+            return false;
+        }
+
+        void skipSpace() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                         text[pos] == '\n' || text[pos] == '\r')) {
+                pos++;
+            }
+        }
+
+        bool expect(char c, const char* what) {
+            skipSpace();
+            if (pos >= text.size() || text[pos] != c) return fail(std::string("expected ") + what);
+            pos++;
+            return true;
+        }
+
+        // A document: one object, or an array of them
+        bool document() {
+            skipSpace();
+            if (pos < text.size() && text[pos] == '[') {
+                pos++;
+                skipSpace();
+                if (pos < text.size() && text[pos] == ']') {
+                    pos++;
+                } else {
+                    while (true) {
+                        if (!object()) return false;
+                        skipSpace();
+                        if (pos < text.size() && text[pos] == ',') {
+                            pos++;
+                            continue;
+                        }
+                        if (!expect(']', "',' or ']' after a job")) return false;
+                        break;
+                    }
+                }
+            } else if (!object()) {
+                return false;
+            }
+            skipSpace();
+            if (pos != text.size()) return fail("unexpected text after the end of the document");
+            return true;
+        }
+
+        bool object() {
+            if (!expect('{', "'{'")) return false;
+            objects.emplace_back();
+            skipSpace();
+            if (pos < text.size() && text[pos] == '}') {
+                pos++;
+                return true;
+            }
+            while (true) {
+                Field field;
+                skipSpace();
+                size_t keyOffset = pos;
+                if (pos >= text.size() || text[pos] != '"') return fail("expected a quoted key");
+                if (!readString(field.key)) return false;
+                if (objects.back().find(field.key)) {
+                    pos = keyOffset;
+                    return fail("duplicate key \"" + std::string(field.key) + "\"");
+                }
+                if (!expect(':', "':' after the key")) return false;
+                if (!value(field)) return false;
+                objects.back().fields.push_back(field);
+
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                return expect('}', "',' or '}'");
+            }
+        }
+
+        // A quoted string starting at pos; out views its characters
+        bool readString(std::string_view& out) {
+            size_t start = ++pos;
+            while (pos < text.size() && text[pos] != '"') {
+                unsigned char c = static_cast<unsigned char>(text[pos]);
+                if (c < 0x20) return fail("unterminated string");
+                if (c == '\\') {
+                    pos++;
+                    if (pos >= text.size()) break;
+                    char e = text[pos];
+                    if (e == 'u') {
+                        for (int k = 1; k <= 4; k++) {
+                            char h = (pos + k < text.size()) ? text[pos + k] : '\0';
+                            bool hex = (h >= '0' && h <= '9') || ((h | 0x20) >= 'a' && (h | 0x20) <= 'f');
+                            if (!hex) return fail("\\u needs four hex digits");
+                        }
+                        pos += 4;
+                    } else if (e != '"' && e != '\\' && e != '/' && e != 'b' && e != 'f' &&
+                               e != 'n' && e != 'r' && e != 't') {
+                        return fail("invalid escape in string");
+                    }
+                }
+                pos++;
+            }
+            if (pos >= text.size()) return fail("unterminated string");
+            out = text.substr(start, pos - start);
+            pos++;
+            return true;
+        }
+
+        bool value(Field& field) {
+            skipSpace();
+            field.offset = pos;
+            if (pos >= text.size()) return fail("expected a value");
+            char c = text[pos];
+            if (c == '"') {
+                field.quoted = true;
+                return readString(field.text);
+            }
+            if (c == '{' || c == '[') return fail("nested objects and arrays are not supported");
+
+            size_t start = pos;
+            while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+                                         text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+                pos++;
+            }
+            field.text = text.substr(start, pos - start);
+            if (field.text == "true" || field.text == "false" || field.text == "null" ||
+                isNumber(field.text)) {
+                return true;
+            }
+            pos = start;
+            return fail("expected a string, number, true, false or null");
+        }
+
+        // JSON number grammar: -?int(.digits)?([eE][+-]?digits)?
+        static bool isNumber(std::string_view token) {
+            size_t i = 0;
+            auto digits = [&]() {
+                size_t from = i;
+                while (i < token.size() && token[i] >= '0' && token[i] <= '9') i++;
+                return i > from;
+            };
+            if (i < token.size() && token[i] == '-') i++;
+            if (!digits()) return false;
+            if (i < token.size() && token[i] == '.') {
+                i++;
+                if (!digits()) return false;
+            }
+            if (i < token.size() && (token[i] == 'e' || token[i] == 'E')) {
+                i++;
+                if (i < token.size() && (token[i] == '+' || token[i] == '-')) i++;
+                if (!digits()) return false;
+            }
+            return i == token.size();
+        }
+    };
 };
 
-#endif
\ No newline at end of file
+#endif
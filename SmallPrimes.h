@@ -0,0 +1,79 @@
+#ifndef SMALLPRIMES_H
+#define SMALLPRIMES_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Odd-only sieve of the numbers below 2^16, run at compile time: bit i of
+// the table stands for 2i + 1
+struct SmallPrimeSieve {
+    static constexpr uint32_t LIMIT = 1u << 16;
+    static constexpr size_t WORDS = LIMIT / 128;
+
+    uint64_t bits[WORDS];
+
+    constexpr SmallPrimeSieve() : bits() {
+        for (size_t w = 0; w < WORDS; w++) bits[w] = ~0ULL;
+        bits[0] &= ~1ULL;   // 1 is not prime
+        for (uint32_t p = 3; p * p < LIMIT; p += 2) {
+            if (!test(p)) continue;
+            for (uint32_t m = p * p; m < LIMIT; m += 2 * p) {
+                bits[m / 128] &= ~(1ULL << (m / 2 % 64));
+            }
+        }
+    }
+
+    constexpr bool test(uint32_t odd) const {
+        return (bits[odd / 128] >> (odd / 2 % 64)) & 1;
+    }
+
+    constexpr uint32_t count() const {
+        uint32_t total = 1;   // 2
+        for (uint32_t n = 3; n < LIMIT; n += 2) {
+            if (test(n)) total++;
+        }
+        return total;
+    }
+};
+
+// Every prime below 2^16, as the sieve and as an ascending list
+// Answers primality of small numbers with one bit lookup and seeds the
+// base-prime table, so the bottom of a search and engine startup do no
+// division or sieving work at run time
+struct SmallPrimeTables {
+    static constexpr uint32_t COUNT = SmallPrimeSieve().count();
+
+    SmallPrimeSieve sieve;
+    uint32_t primes[COUNT];
+
+    constexpr SmallPrimeTables() : sieve(), primes() {
+        uint32_t count = 0;
+        primes[count++] = 2;
+        for (uint32_t n = 3; n < SmallPrimeSieve::LIMIT; n += 2) {
+            if (sieve.test(n)) primes[count++] = n;
+        }
+    }
+};
+
+inline constexpr SmallPrimeTables smallPrimeTables{};
+
+class SmallPrimes {
+public:
+    static const uint32_t LIMIT = SmallPrimeSieve::LIMIT;
+    static const uint32_t COUNT = SmallPrimeTables::COUNT;
+
+    // Exact primality for n < LIMIT
+    static constexpr bool isPrime(uint64_t n) {
+        if (n % 2 == 0) return n == 2;
+        return smallPrimeTables.sieve.test(static_cast<uint32_t>(n));
+    }
+
+    static const uint32_t* begin() { return smallPrimeTables.primes; }
+    static const uint32_t* end() { return smallPrimeTables.primes + COUNT; }
+};
+
+static_assert(SmallPrimes::COUNT == 6542, "pi(2^16) is 6542");
+static_assert(SmallPrimes::isPrime(65521) && !SmallPrimes::isPrime(65535) &&
+              !SmallPrimes::isPrime(1) && SmallPrimes::isPrime(2), "small prime table");
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include "Affinity.h"
+
+// Fixed-size pool of long-lived worker threads
+// Tasks are queued with submit() and wait() blocks until every submitted
+// task has finished, so the pool can be reused for many rounds of work.
+// Worker i can be pinned to a CPU from Affinity::placement
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::vector<std::function<void()>> tasks; // Ring of queued tasks, grown by doubling
+    size_t head = 0;                         // Oldest queued task
+    size_t queued = 0;
+    std::mutex mtx;
+    std::condition_variable taskAvailable;   // Signals workers that a task was queued
+    std::condition_variable allDone;         // Signals wait() that the queue drained
+    int pending = 0;                         // Tasks queued or still running
+    bool stopping = false;
+
+    // Doubles the ring, keeping the queued tasks in order. The ring only
+    // grows, so a pool running rounds of the same size stops allocating
+    void grow() {
+        std::vector<std::function<void()>> larger(std::max<size_t>(16, tasks.size() * 2));
+        for (size_t i = 0; i < queued; i++) {
+            larger[i] = std::move(tasks[(head + i) % tasks.size()]);
+        }
+        tasks.swap(larger);
+        head = 0;
+    }
+
+    void workerLoop(int cpu) {
+        if (cpu >= 0) Affinity::pinCurrentThread(cpu);
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                taskAvailable.wait(lock, [this] { return stopping || queued > 0; });
+                if (stopping && queued == 0) return;
+                task = std::move(tasks[head]);
+                tasks[head] = nullptr;
+                head = (head + 1) % tasks.size();
+                queued--;
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--pending == 0) allDone.notify_all();
+        }
+    }
+
+public:
+    // cpus, if not empty, gives the CPU of each worker
+    explicit ThreadPool(int numThreads, const std::vector<int>& cpus = std::vector<int>()) {
+        for (int i = 0; i < numThreads; i++) {
+            int cpu = (static_cast<size_t>(i) < cpus.size()) ? cpus[i] : -1;
+            workers.emplace_back(&ThreadPool::workerLoop, this, cpu);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Queue a task to run on the next free worker. Tasks that capture no
+    // more than two pointers' worth fit inside std::function and are
+    // queued without touching the heap
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (queued == tasks.size()) grow();
+            tasks[(head + queued) % tasks.size()] = std::move(task);
+            queued++;
+            pending++;
+        }
+        taskAvailable.notify_one();
+    }
+
+    // Completion barrier: block until all submitted tasks have finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <cstdint>
+
+// Wheel factorization tables for a modulus M = 2*3*5 (30) or 2*3*5*7 (210)
+// Only the "spokes", the residues coprime to M, can hold a prime above the
+// wheel primes, so candidates skip 73% (M = 30) or 77% (M = 210) of numbers
+template <uint32_t M>
+struct WheelTables {
+    static constexpr uint32_t gcd(uint32_t a, uint32_t b) { return b == 0 ? a : gcd(b, a % b); }
+
+    static constexpr uint32_t countSpokes() {
+        uint32_t count = 0;
+        for (uint32_t r = 1; r < M; r++) {
+            if (gcd(r, M) == 1) count++;
+        }
+        return count;
+    }
+
+    static constexpr uint32_t SPOKES = countSpokes();
+
+    uint32_t residue[SPOKES];   // Spoke residues, ascending
+    uint32_t gap[SPOKES];       // Distance from each spoke to the next one
+    int32_t spoke[M];           // Spoke of each residue, -1 if not coprime to M
+    uint32_t nextSpoke[M];      // First spoke with residue >= r, SPOKES if none
+
+    constexpr WheelTables() : residue(), gap(), spoke(), nextSpoke() {
+        uint32_t count = 0;
+        for (uint32_t r = 0; r < M; r++) {
+            spoke[r] = -1;
+            if (gcd(r, M) == 1) {
+                spoke[r] = static_cast<int32_t>(count);
+                residue[count++] = r;
+            }
+        }
+        for (uint32_t s = 0; s < SPOKES; s++) {
+            gap[s] = (s + 1 < SPOKES ? residue[s + 1] : M + residue[0]) - residue[s];
+        }
+        uint32_t next = SPOKES;
+        for (uint32_t r = M; r-- > 0;) {
+            if (spoke[r] >= 0) next = static_cast<uint32_t>(spoke[r]);
+            nextSpoke[r] = next;
+        }
+    }
+};
+
+template <uint32_t M>
+constexpr WheelTables<M> wheelTables{};
+
+template <uint32_t M>
+class Wheel {
+public:
+    static const uint32_t MODULUS = M;
+    static const uint32_t SPOKES = WheelTables<M>::SPOKES;
+
+    // Numbers coprime to M in [start, end], in ascending order
+    // The wheel primes themselves are not coprime and must be handled apart
+    class Candidates {
+    public:
+        class iterator {
+        public:
+            iterator(uint64_t v, uint32_t s) : value(v), spoke(s) {}
+            uint64_t operator*() const { return value; }
+            iterator& operator++() {
+                value += wheelTables<M>.gap[spoke];
+                spoke = (spoke + 1 == SPOKES) ? 0 : spoke + 1;
+                return *this;
+            }
+            bool operator!=(const iterator& other) const { return value != other.value; }
+
+        private:
+            uint64_t value;
+            uint32_t spoke;
+        };
+
+        Candidates(uint64_t start, uint64_t end)
+            : first(firstCandidate(start)), last(firstCandidate(end + 1)) {}
+        iterator begin() const { return first; }
+        iterator end() const { return last; }
+
+    private:
+        iterator first;
+        iterator last;
+    };
+
+    static Candidates candidates(uint64_t start, uint64_t end) { return Candidates(start, end); }
+
+    // True if n has no factor in common with M
+    static bool isCandidate(uint64_t n) { return wheelTables<M>.spoke[n % M] >= 0; }
+
+    // Smallest candidate >= n, as a (value, spoke) iterator
+    static typename Candidates::iterator firstCandidate(uint64_t n) {
+        uint64_t turn = n / M;
+        uint32_t s = wheelTables<M>.nextSpoke[n % M];
+        if (s == SPOKES) {
+            turn++;
+            s = 0;
+        }
+        return typename Candidates::iterator(turn * M + wheelTables<M>.residue[s], s);
+    }
+};
+
+#endif
@@ -1,10 +1,114 @@
 #include "PrimeFinder.h"
+#include "Benchmark.h"
+#include "Regression.h"
+#include "CommandLine.h"
+#include "ResultFile.h"
+#include "Cluster.h"
 #include <iostream>
 #include <string>
 #include <algorithm>
 #include <cstdlib>
 
-int main() {
+int main(int argc, char* argv[]) {
+    // FEATURE: Non-interactive benchmark mode (main --bench ...)
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        BenchmarkOptions options;
+        if (!Benchmark::parseArgs(argc, argv, options)) return 1;
+        return Benchmark(options).run();
+    }
+    
+    // FEATURE: Regression suite (main --regress ...)
+    if (argc > 1 && std::string(argv[1]) == "--regress") {
+        RegressionOptions options;
+        if (!Regression::parseArgs(argc, argv, options)) return 1;
+        return Regression(options).run();
+    }
+    
+    // FEATURE: Query a binary result file (main --query FILE ...)
+    if (argc > 1 && std::string(argv[1]) == "--query") {
+        return ResultReader::query(argc, argv);
+    }
+    
+    // FEATURE: Cluster worker (main --serve [ADDRESS:]PORT [options])
+    // Listens on loopback unless an address is given. The options configure
+    // the local engine; argv is shifted so the port stands in for the
+    // program name
+    if (argc > 2 && std::string(argv[1]) == "--serve") {
+        std::string where = argv[2];
+        std::string host = ClusterWorker::DEFAULT_BIND_ADDRESS;
+        size_t colon = where.rfind(':');
+        if (colon != std::string::npos) {
+            host = where.substr(0, colon);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+                host = host.substr(1, host.size() - 2);   // [IPv6]:port
+            }
+            where = where.substr(colon + 1);
+        }
+        uint64_t port = 0;
+        if (host.empty() || !PrimeFinder::parseNumber(where, port) || port == 0 || port > 65535) {
+            std::cerr << "Error: --serve needs [ADDRESS:]PORT\n";
+            return 1;
+        }
+        CommandLine cli;
+        if (!cli.parse(argc - 2, argv + 2)) return 1;
+        Config cfg;
+        ConfigError error;
+        if (cli.useConfigFile && !PrimeFinder::loadConfig(cli.configFile, cfg, error)) {
+            std::cerr << "Error: " << error.describe() << "\n";
+            return 1;
+        }
+        if (!cli.apply(cfg)) return 1;
+        return PrimeFinder(cfg).serve(host, static_cast<uint16_t>(port));
+    }
+    
+    // FEATURE: Headless mode (any command-line flag)
+    // Flags override config.json, or replace it with --no-config, and the
+    // search starts straight away: no prompts and no screen clearing
+    CommandLine cli;
+    if (!cli.parse(argc, argv)) return 1;
+    if (cli.showHelp) {
+        CommandLine::printUsage(std::cout);
+        return 0;
+    }
+    // FEATURE: Job arrays
+    // A config file holding [{...}, {...}] runs every job in turn, with the
+    // flags applied to each, on one engine whose pool stays warm. Every job
+    // is parsed and validated before the first one starts; a job that then
+    // fails at run time is reported and the rest still run
+    if (cli.headless) {
+        std::vector<Config> jobs(1);
+        ConfigError error;
+        if (cli.useConfigFile && !PrimeFinder::loadJobs(cli.configFile, jobs, error)) {
+            std::cerr << "Error: " << error.describe() << "\n";
+            return 1;
+        }
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (!cli.apply(jobs[i])) return 1;
+            if (!PrimeFinder::validate(jobs[i], error)) {
+                if (jobs.size() > 1) error.message = "job " + std::to_string(i + 1) + ": " + error.message;
+                std::cerr << "Error: " << error.describe() << "\n";
+                return 1;
+            }
+        }
+        
+        // Tuned settings are only saved back to a single-job file
+        PrimeFinder finder(jobs[0], (cli.useConfigFile && jobs.size() == 1) ? cli.configFile : std::string());
+        std::vector<size_t> failed;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs.size() > 1) {
+                std::cout << "\n=== Job " << (i + 1) << " of " << jobs.size() << " ===" << std::endl;
+            }
+            finder.setConfig(jobs[i]);
+            if (!finder.run()) failed.push_back(i + 1);
+        }
+        if (jobs.size() > 1 && !failed.empty()) {
+            std::cerr << "\nError: " << failed.size() << " of " << jobs.size() << " jobs failed:";
+            for (size_t job : failed) std::cerr << " " << job;
+            std::cerr << "\n";
+        }
+        return failed.empty() ? 0 : 1;
+    }
+    
     // FEATURE: Clear screen at startup for clean interface
     #ifdef _WIN32
         system("cls");
@@ -43,6 +147,5 @@ int main() {
         system("clear");
     #endif
     
-    finder.run();
-    return 0;
+    return finder.run() ? 0 : 1;
 }
\ No newline at end of file